@@ -0,0 +1,68 @@
+/*
+ * libgmxcpp
+ * Copyright (C) 2015 James W. Barnett <jbarnet4@tulane.edu>
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The full license is located in a text file titled "LICENSE" in the root
+ * directory of the source.
+ *
+ */
+
+/** @file
+ * @brief Example trajectory server for use with libgmxcpp.
+ *
+ * @details This program keeps trajectories open for other programs on the
+ * same machine, which use them through a TrajectoryClient. It runs until it
+ * is interrupted (e.g. with Ctrl-C).
+ *
+ * Usage: server [socket] [memory budget in MB per xtc file]
+ *
+ */
+
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "gmxcpp/TrajectoryServer.h"
+
+using namespace std;
+
+static TrajectoryServer *server = NULL;
+
+static void stop(int)
+{
+    server->Stop();
+}
+
+int main(int argc, char *argv[])
+{
+    string socketPath = (argc > 1) ? argv[1] : "/tmp/gmxcpp.sock";
+    size_t budget = (argc > 2) ? atol(argv[2]) : 1024;
+
+    try
+    {
+        TrajectoryServer s(socketPath, budget << 20);
+        server = &s;
+        signal(SIGINT, stop);
+        signal(SIGTERM, stop);
+        s.Run();
+    }
+    catch (runtime_error &excpt)
+    {
+        cerr << excpt.what() << endl;
+        return 1;
+    }
+    return 0;
+}
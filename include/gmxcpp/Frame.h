@@ -28,6 +28,8 @@
 
 #ifndef FRAME_H
 #define FRAME_H
+#include <memory>
+#include <stdint.h>
 #include "gmxcpp/Index.h"
 #include "gmxcpp/Utils.h"
 #include "gmxcpp/coordinates.h"
@@ -43,7 +45,11 @@
  * elements. It is pointer here so that later it will be initialized
  * as an array containing the coordinates of all of the atoms of the frame.
  * The matrix type is just a 3 x 3 array. Frame objects are usually not created
- * on their own, but instead are created as a vector in a Trajectory object.
+ * on their own, but instead are created as a vector in a Trajectory object,
+ * where each is a view into the FrameArena holding the coordinates of all
+ * frames. Copying a Frame is cheap: the copy shares the same coordinates.
+ * A Frame can also keep the coordinates as the integers they are stored as in
+ * the XTC file, which are converted to coordinates when asked for.
  */
 
 class Frame {
@@ -57,6 +63,18 @@ float time;
 /** Coordinates for all atoms in this frame. rvec comes from libxdrfile.
  * */
 rvec *x;
+/** Keeps the storage x (or q16 or q32) points into alive, shared between
+ * copies. */
+shared_ptr <void> storage;
+/** When x is NULL, the coordinates stored quantized: either as 16 bit
+ * integers added to qmin, or as 32 bit integers, in units of 1/precision. */
+const uint16_t *q16 = NULL;
+const int32_t *q32 = NULL;
+int qmin[DIM];
+float invprec = 0.0;
+/** Gets the coordinates of an atom, converting them into tmp if they are
+ * stored quantized. */
+const float* xyz(int atom, rvec tmp) const;
 /** Box dimensions for this frame. matrix comes from libxdrfile. */
 matrix box;
 public:
@@ -64,11 +82,6 @@ public:
 /** @brief Blank constructor used in Trajectory. */
 Frame();
 
-~Frame();
-
-Frame(const Frame& other);
-
-Frame& operator=(const Frame& other);
 
 /** @brief A constructor where the private data for the object is set.
  * @param step The step number corresponding with this simulation frame.
@@ -80,6 +93,54 @@ Frame& operator=(const Frame& other);
  * */
 Frame(int &step, float &time, matrix &box, rvec *x, int &natoms);
 
+/** @brief A constructor which uses coordinates that are already stored, e.g.
+ * in a FrameArena, instead of copying them.
+ * @param step The step number corresponding with this simulation frame.
+ * @param time The time (in picoseconds) corresponding with this
+ * simulation frame.
+ * @param box The box dimensions for this frame.
+ * @param x The coordinates of every atom in this frame.
+ * @param natoms The number of atoms in the frame.
+ * */
+Frame(int &step, float &time, matrix &box, shared_ptr <float> x, int natoms);
+
+/** @brief A constructor which only keeps some of the atoms.
+ * @param step The step number corresponding with this simulation frame.
+ * @param time The time (in picoseconds) corresponding with this
+ * simulation frame.
+ * @param box The box dimensions for this frame.
+ * @param x The coordinates of every atom in the system.
+ * @param atoms The atom numbers (in the system) of the atoms to keep. They are
+ * stored in this order, so atom i of this frame is atoms[i] of the system.
+ * */
+Frame(int &step, float &time, matrix &box, rvec *x, const vector <int> &atoms);
+
+/** @brief A constructor with the step, time, box and number of atoms of
+ * another frame, but different coordinates, e.g. those of a frame kept
+ * compressed and decoded when used.
+ * @param frame The frame whose step, time, box and number of atoms are used.
+ * @param x The coordinates of every atom in this frame.
+ * */
+Frame(const Frame &frame, shared_ptr <float> x);
+
+/** @brief A constructor which keeps the coordinates quantized.
+ * @details The coordinates are kept as the integers they are stored as in the
+ * XTC file. If the integers of each dimension span less than 2^16 they are
+ * kept as 16 bit offsets from the lowest one, otherwise as 32 bit integers.
+ * They are converted exactly as when the frame is decoded to floats, so the
+ * coordinates are the same. Such a frame cannot be centered.
+ * @param step The step number corresponding with this simulation frame.
+ * @param time The time (in picoseconds) corresponding with this
+ * simulation frame.
+ * @param box The box dimensions for this frame.
+ * @param x The integers of every atom in the system, see read_xtc_int.
+ * @param prec The precision of the integers.
+ * @param natoms The number of atoms in the system.
+ * @param atoms The atom numbers (in the system) of the atoms to keep, in this
+ * order. If empty, all atoms are kept.
+ * */
+Frame(int &step, float &time, matrix &box, const int *x, float prec, int natoms, const vector <int> &atoms);
+
 /**
  * @brief the simulation time in picoseconds of this frame.
  * @return Time
@@ -0,0 +1,105 @@
+/*
+ * libgmxcpp
+ * Copyright (C) 2015 James W. Barnett <jbarnet4@tulane.edu>
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The full license is located in a text file titled "LICENSE" in the root
+ * directory of the source.
+ *
+ */
+
+/** @file
+ * @brief Header for the FrameArena class
+ * */
+
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+#include <cstddef>
+#include <memory>
+#include "xdrfile.h"
+using namespace std;
+
+/**
+ * @brief Contiguous storage for the coordinates of many frames.
+ *
+ * @details Instead of each Frame allocating its own array, frames are carved
+ * one after another out of large blocks, each holding the coordinates of a
+ * fixed number of frames. When the number of frames to be read is known the
+ * block is sized for all of them up front. Each Frame keeps its block alive, so
+ * a block is freed once every frame in it is gone. Blocks are mapped lazily
+ * by the system, so space for frames that are never read does not use memory.
+ */
+class FrameArena {
+private:
+
+/* Number of atoms in each frame. */
+int natoms;
+
+/* Number of frames in each block. */
+size_t frames;
+
+/* Number of frames handed out from the current block. */
+size_t used;
+
+/* Number of floats the current block can hold. */
+size_t size;
+
+/* Whether blocks should be backed by huge pages. */
+bool hugePages;
+
+/* The block frames are currently being carved from. */
+shared_ptr <float> block;
+
+/* Allocates a new block of n floats. */
+shared_ptr <float> allocate(size_t n) const;
+
+public:
+
+/** @brief Blank constructor. */
+FrameArena();
+
+/** @brief Copies the settings of other, but not its storage, so two arenas
+ * never hand out the same space. */
+FrameArena(const FrameArena &other);
+
+/** @brief Copies the settings of other, but not its storage. */
+FrameArena& operator=(const FrameArena &other);
+
+/**
+ * @brief Starts handing out storage for frames of a new size.
+ * @details The current block is reused if no frame still points into it and
+ * it is large enough, otherwise a new one is allocated when needed.
+ * @param natoms Number of atoms in each frame.
+ * @param nframes Number of frames expected, which is the size of each block.
+ */
+void Reset(int natoms, size_t nframes);
+
+/**
+ * @brief Sets whether blocks are backed by huge pages, where the system
+ * supports it. Applies to blocks allocated afterwards.
+ * @param on Whether to use huge pages.
+ */
+void SetHugePages(bool on);
+
+/**
+ * @brief Gets the storage for the coordinates of the next frame.
+ * @return Pointer to natoms coordinates, which keeps its block alive.
+ */
+shared_ptr <float> Next();
+
+};
+
+#endif
@@ -0,0 +1,155 @@
+/*
+ * libgmxcpp
+ * Copyright (C) 2015 James W. Barnett <jbarnet4@tulane.edu>
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The full license is located in a text file titled "LICENSE" in the root
+ * directory of the source.
+ *
+ */
+
+/** @file
+ * @brief Header for the FrameCache class
+ * */
+
+#ifndef FRAMECACHE_H
+#define FRAMECACHE_H
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <stdexcept>
+#include "xdrfile.h"
+using namespace std;
+
+/**
+ * @brief A trajectory decoded once and saved in a form that can be used
+ * straight from disk.
+ *
+ * @details Decompressing an XTC file is by far the most expensive part of
+ * reading it. A cache file (traj.xtc -> traj.xtc.cache) holds the same
+ * frames already decoded, as little-endian floats laid out exactly like the
+ * coordinates of a Frame, each frame starting on a 64 byte boundary. A header
+ * holds the number of atoms and frames, followed by a table with the offset,
+ * step, time and box of every frame. The cache is mapped into memory when
+ * opened, and frames read from it point straight into the mapping, so
+ * nothing is decoded or copied. Pages are only read from disk when a frame is
+ * used.
+ *
+ * The same layout can be published in POSIX shared memory instead of a file,
+ * so that one process decodes a trajectory and any number of processes on
+ * the same machine use the same copy of it in memory.
+ */
+class FrameCache {
+private:
+
+/* The name of the cache file. */
+string cachefile;
+
+/* Number of atoms in the system. */
+int natoms;
+
+/* Number of frames in the cache. */
+int nframes;
+
+/* The mapped file. */
+shared_ptr <unsigned char> data;
+
+/* Gets the entry of a frame in the table, checking the frame number. */
+const void* entry(int frame) const;
+
+public:
+
+/**
+ * @brief Constructor which maps a cache file.
+ * @param cachefile Name of the cache file, or "shm:" followed by the name of
+ * a shared memory object made by Publish (e.g. "shm:/traj").
+ */
+FrameCache(string cachefile);
+
+/**
+ * @brief Decodes every frame of an XTC file and saves them in a cache file.
+ * @details Frames are decoded one at a time, so this does not need more
+ * memory than one frame.
+ * @param xtcfile Name of the Gromacs XTC file.
+ * @param cachefile Name of the cache file to be written. By default the name
+ * of the XTC file with .cache added.
+ * @return Number of frames written.
+ */
+static int Write(string xtcfile, string cachefile = "");
+
+/**
+ * @brief Decodes every frame of an XTC file into a shared memory object.
+ * @details The object holds the same as a cache file and is opened as
+ * "shm:" followed by its name, e.g. by Trajectory("shm:/traj"). Processes
+ * opening it share its memory, and changes they make to frames (e.g. with
+ * Frame::CenterAtoms) stay their own. It stays until Unpublish is called
+ * (or the machine is restarted), even after this process exits. An object
+ * with the same name is replaced, and processes that have it open keep
+ * using the old one.
+ * @param xtcfile Name of the Gromacs XTC file.
+ * @param name Name of the shared memory object, starting with "/".
+ * @param nthreads Number of threads decoding frames.
+ * @return Number of frames published.
+ */
+static int Publish(string xtcfile, string name, int nthreads = 1);
+
+/**
+ * @brief Removes a shared memory object made by Publish. Processes that
+ * have it open can keep using it.
+ * @param name Name of the shared memory object, starting with "/".
+ */
+static void Unpublish(string name);
+
+/**
+ * @brief Gets the number of frames in the cache.
+ */
+int GetNFrames() const;
+
+/**
+ * @brief Gets the number of atoms in the system.
+ */
+int GetNAtoms() const;
+
+/**
+ * @brief Gets the step of a frame.
+ * @param frame Frame number in the cache.
+ */
+int GetStep(int frame) const;
+
+/**
+ * @brief Gets the time of a frame in picoseconds.
+ * @param frame Frame number in the cache.
+ */
+float GetTime(int frame) const;
+
+/**
+ * @brief Gets the box of a frame.
+ * @param frame Frame number in the cache.
+ * @param box Where the box is written.
+ */
+void GetBox(int frame, matrix box) const;
+
+/**
+ * @brief Gets the coordinates of a frame.
+ * @details The pointer is into the mapping, which it keeps alive. The mapping
+ * is private, so changing the coordinates does not change the file.
+ * @param frame Frame number in the cache.
+ */
+shared_ptr <float> GetXYZ(int frame) const;
+
+};
+
+#endif
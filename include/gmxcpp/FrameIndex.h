@@ -0,0 +1,155 @@
+/*
+ * libgmxcpp
+ * Copyright (C) 2015 James W. Barnett <jbarnet4@tulane.edu>
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The full license is located in a text file titled "LICENSE" in the root
+ * directory of the source.
+ *
+ */
+
+/** @file
+ * @brief Header for the FrameIndex class
+ * */
+
+#ifndef FRAMEINDEX_H
+#define FRAMEINDEX_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <stdexcept>
+using namespace std;
+
+/**
+ * @brief Byte offset, step and time of every frame in an XTC file.
+ *
+ * @details The index is built in one pass over the XTC file and saved next to
+ * it (traj.xtc -> traj.xtc.idx) so that later runs can load it instead of
+ * scanning again. The size and modification time of the XTC file are stored
+ * in the index file; if either has changed when the index is loaded, it is
+ * rebuilt. If the index file cannot be written (e.g. read-only directory) the
+ * index is only kept in memory.
+ */
+class FrameIndex {
+private:
+
+/* The name of the xtc file this index belongs to. */
+string xtcfile;
+
+/* The name of the index file saved next to the xtc file. */
+string idxfile;
+
+/* Number of atoms in the system. */
+int natoms;
+
+/* Size and modification time (ns) of the xtc file when the index was built. */
+int64_t fsize;
+int64_t fmtime;
+
+/* Byte offset of the start of each frame. */
+vector <int64_t> offsets;
+
+/* Step and time of each frame. */
+vector <int> steps;
+vector <float> times;
+
+/* Gets the size and modification time of the xtc file. */
+bool stat(int64_t &size, int64_t &mtime) const;
+
+/* Loads the index file, returns false if missing or stale. */
+bool load();
+
+/* Builds the index by scanning the xtc file. */
+void build();
+
+/* Saves the index file, returns false if it could not be written. */
+bool save() const;
+
+public:
+
+/** @brief Blank constructor. */
+FrameIndex();
+
+/**
+ * @brief Constructor which loads or builds the index for an XTC file.
+ * @param xtcfile Name of the Gromacs XTC file.
+ */
+FrameIndex(string xtcfile);
+
+/**
+ * @brief Loads the saved index for an XTC file, or builds and saves a new
+ * one if none exists or the XTC file changed since it was built.
+ * @param xtcfile Name of the Gromacs XTC file.
+ * @param verbose Whether to print what is being done.
+ */
+void init(string xtcfile, bool verbose = true);
+
+/**
+ * @brief Loads the saved index for an XTC file, but does not build one if
+ * none exists or the XTC file changed since it was built.
+ * @param xtcfile Name of the Gromacs XTC file.
+ * @return Whether the index was loaded.
+ */
+bool initSaved(string xtcfile);
+
+/**
+ * @brief Whether the index has been loaded or built.
+ */
+bool IsLoaded() const;
+
+/**
+ * @brief Whether the XTC file changed size or modification time since the
+ * index was built.
+ */
+bool IsStale() const;
+
+/**
+ * @brief Gets the number of complete frames in the XTC file.
+ */
+int GetNFrames() const;
+
+/**
+ * @brief Gets the number of atoms in the system.
+ */
+int GetNAtoms() const;
+
+/**
+ * @brief Gets the byte offset of the start of a frame.
+ * @param frame Frame number in the file.
+ */
+int64_t GetOffset(int frame) const;
+
+/**
+ * @brief Gets the step of a frame.
+ * @param frame Frame number in the file.
+ */
+int GetStep(int frame) const;
+
+/**
+ * @brief Gets the time of a frame in picoseconds.
+ * @param frame Frame number in the file.
+ */
+float GetTime(int frame) const;
+
+/**
+ * @brief Gets the name of the index file.
+ */
+string GetFilename() const;
+
+};
+
+#endif
@@ -0,0 +1,174 @@
+/*
+ * libgmxcpp
+ * Copyright (C) 2015 James W. Barnett <jbarnet4@tulane.edu>
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The full license is located in a text file titled "LICENSE" in the root
+ * directory of the source.
+ *
+ */
+
+/** @file
+ * @brief Header for the FrameStore class
+ * */
+
+#ifndef FRAMESTORE_H
+#define FRAMESTORE_H
+
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "xdrfile.h"
+using namespace std;
+
+/**
+ * @brief Frames kept in memory as they are in the XTC file, decoded only when
+ * used.
+ *
+ * @details Decoded coordinates take 10-20 times as much memory as compressed
+ * ones. The store keeps the compressed data of each frame and decodes a frame
+ * the first time its coordinates are asked for. The most recently used
+ * decoded frames are kept, up to a fixed number, so going through frames in
+ * order or going back to the same frame only decodes each once. Getting a
+ * frame can be done from several threads at once.
+ *
+ * A store can also leave the compressed frames in the XTC file, which is then
+ * mapped into memory, so it only keeps where each frame is. Then only the
+ * decoded frames take memory, however large the file. When frames are gotten
+ * in order, the next few are decoded ahead by a background thread.
+ */
+class FrameStore {
+private:
+
+/* Number of atoms in the system. */
+int natoms;
+
+/* Atoms (numbered in the system) kept when a frame is decoded, or empty for
+ * all of them. */
+vector <int> atoms;
+
+/* Maximum number of decoded frames kept. */
+size_t capacity;
+
+/* Compressed frames one after another. */
+vector <unsigned char> data;
+
+/* The XTC file, and its size, when frames are left in it. */
+string xtcfile;
+shared_ptr <unsigned char> mapped;
+int64_t mapsize;
+
+/* Where each frame starts in data or in the file, and its size. */
+vector <int64_t> offsets;
+vector <int64_t> sizes;
+
+/* Decoded frames, most recently used first, and where each is in the list. */
+mutable mutex lock;
+mutable list <pair <int, shared_ptr <float> > > recent;
+mutable unordered_map <int, list <pair <int, shared_ptr <float> > >::iterator> decoded;
+
+/* Number of frames decoded ahead when frames are gotten in order, the last
+ * frame gotten, and the frames waiting to be decoded ahead (or being
+ * decoded) by the background thread. */
+int readahead;
+mutable int lastFrame;
+mutable deque <int> ahead;
+mutable unordered_set <int> queued;
+mutable bool stopping;
+mutable condition_variable changed;
+mutable thread worker;
+
+/* Decodes a frame. */
+shared_ptr <float> decode(int frame) const;
+
+/* Keeps a decoded frame as the most recently used one. Called with the lock
+ * held. */
+void keep(int frame, shared_ptr <float> x) const;
+
+/* Decodes the frames waiting to be decoded ahead until stopping. */
+void decodeAhead() const;
+
+public:
+
+/**
+ * @brief Constructor for an empty store.
+ * @param natoms Number of atoms in the system.
+ * @param atoms Atoms (numbered in the system) kept when a frame is decoded,
+ * in this order. If empty, all atoms are kept.
+ * @param capacity Maximum number of decoded frames kept.
+ */
+FrameStore(int natoms, const vector <int> &atoms, size_t capacity);
+
+/**
+ * @brief Constructor for an empty store which leaves the compressed frames in
+ * the XTC file.
+ * @param xtcfile Name of the XTC file frames are added from.
+ * @param natoms Number of atoms in the system.
+ * @param atoms Atoms (numbered in the system) kept when a frame is decoded,
+ * in this order. If empty, all atoms are kept.
+ * @param capacity Maximum number of decoded frames kept.
+ * @param readahead Number of frames decoded ahead when frames are gotten in
+ * order.
+ */
+FrameStore(string xtcfile, int natoms, const vector <int> &atoms, size_t capacity, int readahead);
+
+~FrameStore();
+
+FrameStore(const FrameStore&) = delete;
+FrameStore& operator=(const FrameStore&) = delete;
+
+/**
+ * @brief Adds the next frame by reading it from an XTC file without decoding
+ * it.
+ * @param xd The XTC file, at the start of the frame. If the store leaves
+ * frames in the file, this must be the same file.
+ * @param step Where the step of the frame is written.
+ * @param time Where the time of the frame is written.
+ * @param box Where the box of the frame is written.
+ * @return 0 on success, or -1 if no complete frame could be read, in which
+ * case nothing is added.
+ */
+int Add(XDRFILE *xd, int *step, float *time, matrix box);
+
+/**
+ * @brief Gets the coordinates of a frame, decoding it if it is not one of
+ * the frames kept decoded.
+ * @param frame Frame number in the store, in the order they were added.
+ * @return The coordinates of the atoms kept. They stay valid while the
+ * pointer is held, even after the frame is no longer kept decoded.
+ */
+shared_ptr <float> Get(int frame) const;
+
+/**
+ * @brief Gets the number of frames in the store.
+ */
+int GetNFrames() const;
+
+/**
+ * @brief Gets the number of bytes of compressed data kept in memory.
+ */
+size_t GetSize() const;
+
+};
+
+#endif
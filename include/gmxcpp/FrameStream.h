@@ -0,0 +1,164 @@
+/*
+ * libgmxcpp
+ * Copyright (C) 2015 James W. Barnett <jbarnet4@tulane.edu>
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The full license is located in a text file titled "LICENSE" in the root
+ * directory of the source.
+ *
+ */
+
+/** @file
+ * @brief Header for the FrameStream class
+ * */
+
+#ifndef FRAMESTREAM_H
+#define FRAMESTREAM_H
+
+#include <iterator>
+#include <string>
+#include "gmxcpp/Frame.h"
+#include "gmxcpp/FrameArena.h"
+#include "gmxcpp/FrameIndex.h"
+#include "xdrfile.h"
+#include "xdrfile_xtc.h"
+using namespace std;
+
+/**
+ * @brief Single pass over the frames of an XTC file, one frame at a time.
+ *
+ * @details Returned by Trajectory::stream and meant to be used in a range-based
+ * for loop:
+ *
+ *     for (const Frame &frame : trj.stream(b, s, e)) { ... }
+ *
+ * Each frame is decoded into the same buffer, overwriting the previous one, so
+ * memory use does not depend on the length of the trajectory. If a copy of a
+ * Frame is kept past the next iteration, the stream notices and decodes into
+ * a new buffer instead, so the copy stays valid. The stream has its own handle
+ * on the XTC file and does not change what the Trajectory has read in. It
+ * uses the frame index of the Trajectory it came from, so it must not outlive
+ * it.
+ */
+class FrameStream {
+private:
+
+/* Handle on the xtc file owned by this stream. */
+XDRFILE *xd;
+
+/* Number of atoms in the system. */
+int natoms;
+
+/* Frame index of the Trajectory, or NULL if frames are never skipped. */
+const FrameIndex *frameIndex;
+
+/* Read every sth frame, stopping at frame e (-1 means the end of the file). */
+int s;
+int e;
+
+/* Number of the next frame to be returned. */
+int next;
+
+/* Frame number of the current file position. */
+int position;
+
+/* Set once the last frame was returned. */
+bool done;
+
+/* Whether the first frame was read. */
+bool started;
+
+/* Storage for the frame being returned, reused between frames. */
+FrameArena arena;
+
+/* The frame being returned. */
+Frame frame;
+
+/* Moves to and decodes the next frame, or sets done. */
+void advance();
+
+public:
+
+/**
+ * @brief Input iterator over the frames of a FrameStream.
+ * @details The Frame it points to is overwritten when it is incremented.
+ */
+class iterator {
+private:
+FrameStream *stream;
+public:
+typedef input_iterator_tag iterator_category;
+typedef Frame value_type;
+typedef ptrdiff_t difference_type;
+typedef const Frame* pointer;
+typedef const Frame& reference;
+
+/** @brief Constructor, where NULL gives the end of the stream. */
+explicit iterator(FrameStream *stream = NULL);
+
+/** @brief The current frame. */
+const Frame& operator*() const;
+
+/** @brief The current frame. */
+const Frame* operator->() const;
+
+/** @brief Decodes the next frame. */
+iterator& operator++();
+
+/** @brief Whether both are at the end, or both are the same stream. */
+bool operator==(const iterator &other) const;
+
+/** @brief Opposite of operator==. */
+bool operator!=(const iterator &other) const;
+};
+
+/**
+ * @brief Opens a stream over every sth frame from b up to e.
+ * @details Like Trajectory::read, only frames that are a multiple of s are
+ * returned.
+ * @param xtcfile Name of the Gromacs XTC file.
+ * @param natoms Number of atoms in the system.
+ * @param frameIndex Frame index used to seek over frames that are not
+ * returned. NULL to read through them instead.
+ * @param arena Arena whose settings (e.g. huge pages) are used for the buffer.
+ * @param b First frame.
+ * @param s Return every sth frame.
+ * @param e Stop at this frame. -1 means go until the end of the file.
+ */
+FrameStream(string xtcfile, int natoms, const FrameIndex *frameIndex,
+            const FrameArena &arena, int b, int s, int e);
+
+/** @brief Takes over the file handle of other. */
+FrameStream(FrameStream &&other) noexcept;
+
+FrameStream(const FrameStream &other) = delete;
+
+FrameStream& operator=(const FrameStream &other) = delete;
+
+/** @brief Closes the file. */
+~FrameStream();
+
+/**
+ * @brief Decodes the first frame and returns an iterator to it. The stream
+ * can only be gone through once.
+ */
+iterator begin();
+
+/** @brief The end of the stream. */
+iterator end();
+
+};
+
+#endif
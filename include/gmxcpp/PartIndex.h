@@ -0,0 +1,137 @@
+/*
+ * libgmxcpp
+ * Copyright (C) 2015 James W. Barnett <jbarnet4@tulane.edu>
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The full license is located in a text file titled "LICENSE" in the root
+ * directory of the source.
+ *
+ */
+
+
+/** @file
+ * @brief Header for the PartIndex class
+ * */
+
+#ifndef PARTINDEX_H
+#define PARTINDEX_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include "gmxcpp/FrameIndex.h"
+using namespace std;
+
+/**
+ * @brief One sequence of frames over a trajectory split into several XTC
+ * files.
+ *
+ * @details Long simulations are often continued in new files (traj.part0001.xtc,
+ * traj.part0002.xtc, ...). The frame index of every file is loaded or built,
+ * several files at a time, and the frames of all files are numbered one after
+ * another in the order the files are given. When a simulation is continued,
+ * the first frame of the new file is usually the same as the last frame of
+ * the one before; if it has the same step it is left out, so every step is
+ * only in the sequence once.
+ */
+class PartIndex {
+private:
+
+/* The name of each file. */
+vector <string> files;
+
+/* The frame index of each file. */
+vector <FrameIndex> indexes;
+
+/* Number (in the sequence) of the first frame of each file, plus the number
+ * of frames in the sequence at the end. */
+vector <int> first;
+
+/* Number of frames at the start of each file that are left out. */
+vector <int> skipped;
+
+public:
+
+/**
+ * @brief Constructor which loads or builds the frame index of each file.
+ * @param xtcfiles Names of the Gromacs XTC files, in the order of the
+ * simulation.
+ */
+PartIndex(const vector <string> &xtcfiles);
+
+/**
+ * @brief Gets the names of the files matching a pattern, sorted.
+ * @details Sorting by name puts files numbered with leading zeros
+ * (traj.part0001.xtc, ...) in order.
+ * @param pattern Shell wildcard pattern, e.g. "traj.part*.xtc".
+ * @return Names of the matching files.
+ */
+static vector <string> Glob(string pattern);
+
+/**
+ * @brief Gets the number of files.
+ */
+int GetNParts() const;
+
+/**
+ * @brief Gets the name of a file.
+ * @param part File number, in the order they were given.
+ */
+string GetFilename(int part) const;
+
+/**
+ * @brief Gets the number of frames in the sequence.
+ */
+int GetNFrames() const;
+
+/**
+ * @brief Gets the number of atoms in the system.
+ */
+int GetNAtoms() const;
+
+/**
+ * @brief Gets the file a frame is in.
+ * @param frame Frame number in the sequence.
+ */
+int GetPart(int frame) const;
+
+/**
+ * @brief Gets the frame number in its file of a frame.
+ * @param frame Frame number in the sequence.
+ */
+int GetLocalFrame(int frame) const;
+
+/**
+ * @brief Gets the byte offset in its file of the start of a frame.
+ * @param frame Frame number in the sequence.
+ */
+int64_t GetOffset(int frame) const;
+
+/**
+ * @brief Gets the step of a frame.
+ * @param frame Frame number in the sequence.
+ */
+int GetStep(int frame) const;
+
+/**
+ * @brief Gets the time of a frame in picoseconds.
+ * @param frame Frame number in the sequence.
+ */
+float GetTime(int frame) const;
+
+};
+
+#endif
@@ -31,10 +31,20 @@
 
 #include <cstring>
 #include "omp.h"
+#include <functional>
+#include <memory>
 #include <string>
 #include <iostream>
 #include "gmxcpp/Frame.h"
+#include "gmxcpp/FrameArena.h"
+#include "gmxcpp/FrameCache.h"
+#include "gmxcpp/FrameIndex.h"
+#include "gmxcpp/FrameStore.h"
+#include "gmxcpp/FrameStream.h"
 #include "gmxcpp/Index.h"
+#include "gmxcpp/PartIndex.h"
+#include "gmxcpp/TrajectoryWindow.h"
+#include "gmxcpp/TrrFile.h"
 #include "gmxcpp/Utils.h"
 #include "gmxcpp/coordinates.h"
 #include "gmxcpp/coordinates4.h"
@@ -46,6 +56,8 @@
 #include <stdexcept>
 using namespace std;
 
+struct Prefetcher;
+
 /**
  * @brief The main class in reading Gromacs files.
  *
@@ -53,6 +65,11 @@ using namespace std;
  * on the simulation (number of atoms). It also contains the special xd
  * pointer that libxdrfile needs to open the xtc file, as well as the number of
  * atoms in the system, the number of frames read in, and an Index object.
+ * Files ending in .trr are read as TRR files instead, which also have
+ * velocities and forces, and files ending in .cache as frames already decoded
+ * by FrameCache::Write. Names starting with shm: are frames decoded into
+ * shared memory by FrameCache::Publish. A trajectory split into several xtc files can be read
+ * as one.
  */
 class Trajectory {
 private:
@@ -69,21 +86,125 @@ int readFrame();
 /* Reads a frame, but does not save it to the vector of Frame objects. */
 int skipFrame();
 
+/* Moves the file position to the start of a frame using the frame index. */
+int seekFrame(int frame);
+
+/* Reads every sth frame from b up to e with several threads. */
+void readParallel(int b, int s, int e);
+
+/* Number of threads used to read frames in read(). */
+int nthreads;
+
+/* Maximum number of frames decoded ahead of read_next by a background
+ * thread. 0 means frames are decoded when read_next is called. */
+int prefetchDepth;
+
+/* The background thread and its queue of decoded frames, started by
+ * read_next when prefetching is on. While it runs, count is the number of the
+ * next frame read_next returns, not the file position. */
+shared_ptr <Prefetcher> prefetcher;
+
+/* Stops the background thread, discarding frames decoded ahead, and sets count
+ * back to the file position. Returns the frame number read_next was at. */
+int stopPrefetch();
+
 void printInfo();
 
 /* Keeps track of the frames being read in (esp. when different than those
- * frames saved. */
+ * frames saved. This is the frame number of the current file position. */
 int count;
 
+/* Byte offset, step and time of each frame in the xtc file, loaded or built
+ * the first time we need to seek. */
+FrameIndex frameIndex;
+
 /* Vector of Frame objects which contain all the data in the trajectory. */
 vector <Frame> frameArray;
 
+/* Contiguous storage for the coordinates of the frames in frameArray. */
+FrameArena arena;
+
+/* Frames are decoded straight into the arena; only when just an index group
+ * is saved are they decoded here first. Kept between frames so it is only
+ * allocated once. */
+vector <float> scratch;
+
 /* Index object containing all group names, sizes, and indices for the trajectory. */
 Index index;
 
 /* Special file pointer required by libxdrfile to read in XTC files. */
 XDRFILE *xd;
 
+/* The mapped file when reading a trr file instead of an xtc file. It stays
+ * mapped after reading, since velocities and forces are read from it only
+ * when asked for. */
+shared_ptr <TrrFile> trr;
+
+/* Frame number in the trr file of each frame in frameArray. */
+vector <int> trrFrame;
+
+/* Gets the frame number in the trr file of a saved frame. */
+int trrFrameOf(int frame) const;
+
+/* The mapped file when reading a cache file written by FrameCache::Write, or
+ * shared memory made by FrameCache::Publish. Frames with all atoms point into
+ * it. */
+shared_ptr <FrameCache> cache;
+
+/* Number of frames in the trr or cache file, or -1 when reading an xtc file. */
+int mappedFrames() const;
+
+/* The frames of all files when reading a trajectory split into several xtc
+ * files. Frame numbers (count, seekFrame) are then in the sequence of all
+ * files, and xd is the file the current frame is in. */
+shared_ptr <PartIndex> parts;
+
+/* The file xd is open on when reading several files. */
+int part;
+
+/* Number of frames in the file(s) if known without building a frame index,
+ * otherwise -1. */
+int knownFrames() const;
+
+/* Number of decoded frames kept when frames are kept compressed, 0 if frames
+ * are decoded when read. */
+int storeFrames;
+
+/* Bytes of decoded frames kept when frames are left in the xtc file, 0 if
+ * they are not. */
+size_t memoryBudget;
+
+/* The compressed frames, when frames are kept compressed. The frames in
+ * frameArray then only have the step, time and box. */
+shared_ptr <FrameStore> store;
+
+/* Starts a new store for the frames about to be read, if they are kept
+ * compressed. */
+void resetStore();
+
+/* Gets a frame with its coordinates, using hold to keep them alive if they
+ * had to be decoded. */
+const Frame& frameAt(int frame, Frame &hold) const;
+
+/* Whether frames are kept as the integers they are stored as in the xtc file. */
+bool quantized;
+
+/* Whether read() throws errors instead of ending the program. */
+bool throwOnError;
+
+/* The integers of the frame being read when frames are kept quantized. */
+vector <int> qscratch;
+
+/* Whether frames are decoded to floats from an xtc file, which is the only
+ * case reading with several threads and prefetching are used for. */
+bool plainXtc() const;
+
+/* Time of a frame in the file, from the frame index or the trr or cache file. */
+float frameTime(int frame) const;
+
+/* Whether a time is a multiple of dt, or dt is 0. */
+static bool onTime(float time, float dt);
+
 /* Precision of coordinates. */
 float prec;
 
@@ -93,6 +214,29 @@ int nframes;
 /* Number of atoms in the simulation. */
 int natoms;
 
+/* Index group whose atoms are the only ones saved in each frame, or empty if
+ * all atoms are saved. */
+string loadedGroup;
+
+/* The atoms (numbered in the entire system) saved in each frame, in the order
+ * they are saved. Empty if all atoms are saved. */
+vector <int> groupAtoms;
+
+/* Where each atom of the system is saved in a frame, -1 if not saved. */
+vector <int> storedLocation;
+
+/* Sets the group whose atoms are saved in each frame, "" for all atoms. */
+void setGroup(string groupName);
+
+/* Number of atoms saved in each frame. */
+int savedAtoms() const;
+
+/* Where an atom of the entire system is saved in a frame. */
+int storedAtom(int atom) const;
+
+/* Where an atom of an index group is saved in a frame. */
+int location(string groupName, int atom) const;
+
 public:
 
 Trajectory();
@@ -137,7 +281,45 @@ Trajectory(string xtcfile, Index index);
  */
 Trajectory(string xtcfile, string ndxfile);
 
+/**
+ * @brief Constructor for a trajectory split into several XTC files.
+ *
+ * @details The files are read as one trajectory, with frames numbered one
+ * after another in the order the files are given. A frame at the start of a
+ * file with the same step as the last frame of the file before is left out.
+ * The frame index of each file is loaded or built when the object is
+ * constructed, several files at a time. Reading with several threads decodes
+ * frames from different files at the same time. Prefetching and stream() are
+ * not used with several files.
+ *
+ * @param xtcfiles Names of the Gromacs XTC files, in the order of the
+ * simulation. PartIndex::Glob gets them from a wildcard pattern.
+ */
+Trajectory(const vector <string> &xtcfiles);
+
+/**
+ * @brief Constructor for a trajectory split into several XTC files which also
+ * incorporates a previously read in Index object.
+ * @param xtcfiles Names of the Gromacs XTC files, in the order of the
+ * simulation.
+ * @param index The Index object which has already had its index file read in.
+ */
+Trajectory(const vector <string> &xtcfiles, Index index);
+
+/**
+ * @brief Constructor for a trajectory split into several XTC files which also
+ * sets a GROMACS index file.
+ * @param xtcfiles Names of the Gromacs XTC files, in the order of the
+ * simulation.
+ * @param ndxfile Name of the Gromacs index file to be read in.
+ */
+Trajectory(const vector <string> &xtcfiles, string ndxfile);
+
 /** @brief Reads in simulation frames into memory and then closes the file.
+ *  @details Frames that are skipped (before b, or in between every sth frame)
+ *  are never read. Instead we seek straight to the next frame to be saved
+ *  using a frame index, which is saved next to the xtc file (traj.xtc.idx) the
+ *  first time it is needed and rebuilt if the xtc file changes.
  *  @param b First frame to be read in. By default, starts at the first frame
  *  (frame 0).
  *  @param s Read in every sth frame.
@@ -146,6 +328,199 @@ Trajectory(string xtcfile, string ndxfile);
  */
 int read(int b = 0, int s = 1, int e = -1);
 
+/** @brief Reads in simulation frames, saving only the atoms of an index group.
+ *  @details Each frame is decoded as usual but only the coordinates of the
+ *  atoms in the group are kept, so memory scales with the size of the group
+ *  instead of the system. The GetXYZ functions still take atom numbers in the
+ *  entire system or in an index group and are remapped to the atoms saved;
+ *  asking for an atom that was not saved throws an exception. GetXYZ(frame)
+ *  returns only the atoms saved.
+ *  @param b First frame to be read in.
+ *  @param s Read in every sth frame.
+ *  @param e Stop reading at this frame. -1 means read until the end of the
+ *  file.
+ *  @param groupName Name of the index group whose atoms are saved.
+ *  @return Number of frames read in.
+ */
+int read(int b, int s, int e, string groupName);
+
+/** @brief Reads in the frames within a range of simulation time.
+ *  @details Frames are picked by the time in their header, and only the
+ *  frames saved are decoded. If a frame index was saved next to the xtc file
+ *  (see read()), or for trr and cache files, the first and last frames are
+ *  found by binary search, which requires times to increase through the
+ *  file. Otherwise the headers are read from the start of the file up to e.
+ *  @param b First time to be read in, in picoseconds.
+ *  @param e Last time to be read in, in picoseconds. -1 means read until the
+ *  end of the file.
+ *  @param dt Only read in frames whose time is a multiple of dt picoseconds.
+ *  0 means every frame.
+ *  @return Number of frames read in.
+ */
+int read_time(float b, float e = -1, float dt = 0);
+
+/** @brief Reads in the frames within a range of simulation time, saving only
+ *  the atoms of an index group.
+ *  @details See read_time(float, float, float) and read(int, int, int,
+ *  string).
+ *  @param b First time to be read in, in picoseconds.
+ *  @param e Last time to be read in, in picoseconds. -1 means read until the
+ *  end of the file.
+ *  @param dt Only read in frames whose time is a multiple of dt picoseconds.
+ *  0 means every frame.
+ *  @param groupName Name of the index group whose atoms are saved.
+ *  @return Number of frames read in.
+ */
+int read_time(float b, float e, float dt, string groupName);
+
+/** @brief Goes through frames one at a time without saving them.
+ *  @details Returns a FrameStream to be used in a range-based for loop:
+ *
+ *      for (const Frame &frame : trj.stream(0, 10)) { ... }
+ *
+ *  Each frame is decoded into the same buffer, so memory use stays constant
+ *  however long the trajectory is. Frames are not added to the Trajectory, so
+ *  use the Frame getters (e.g. frame.GetXYZ(atom)) inside the loop. The stream
+ *  has its own handle on the xtc file and must not outlive the Trajectory.
+ *  @param b First frame.
+ *  @param s Go through every sth frame.
+ *  @param e Stop at this frame. -1 means go until the end of the file.
+ *  @return A FrameStream over the frames.
+ */
+FrameStream stream(int b = 0, int s = 1, int e = -1);
+
+/** @brief Goes forward through the frames keeping the last few of them.
+ *  @details Returns a TrajectoryWindow holding at most length frames, for
+ *  analyses that need frames a lag apart at the same time:
+ *
+ *      TrajectoryWindow win = trj.window(100);
+ *      while (win.Advance()) { ... win.GetXYZ(win.GetFirst(), atom) ... }
+ *
+ *  Frames are gotten from the window by their frame number in the file. The
+ *  window has its own handle on the xtc file and must not outlive the
+ *  Trajectory.
+ *  @param length Number of frames kept.
+ *  @param b First frame.
+ *  @param groupName Name of the index group whose atoms are kept, or "" for
+ *  all atoms. Atoms are then numbered in the group.
+ *  @return A TrajectoryWindow with no frames read yet.
+ */
+TrajectoryWindow window(int length, int b = 0, string groupName = "");
+
+/** @brief Follows an xtc file that is still being written, e.g. by a running
+ *  simulation, passing each frame to a function as soon as it is complete.
+ *  @details Starts at the frame read_next would read next (the first frame
+ *  right after the object is constructed) and waits for new frames at the end
+ *  of the file. On Linux the file is watched with inotify, so a new frame is
+ *  handed over within milliseconds of being written; elsewhere the file is
+ *  checked every 10 ms. A frame only partly written is left until the rest of
+ *  it is. Frames are not added to the Trajectory, and earlier frames are never
+ *  read again; afterwards read_next continues after the last frame followed.
+ *  @param callback Called with each new frame. Return false to stop
+ *  following.
+ *  @param timeout Stop after no new frame was written for this many seconds.
+ *  -1 means only stop when the callback returns false.
+ *  @return Number of frames passed to the callback.
+ */
+int follow(function <bool(const Frame&)> callback, double timeout = -1);
+
+/** @brief Follows an xtc file that is still being written, passing the atoms
+ *  of an index group in each frame to a function.
+ *  @details See follow(function <bool(const Frame&)>, double). The frames
+ *  only have the atoms of the group, in the order of the group, so the i-th
+ *  atom of the group is frame.GetXYZ(i).
+ *  @param callback Called with each new frame. Return false to stop
+ *  following.
+ *  @param timeout Stop after no new frame was written for this many seconds.
+ *  -1 means only stop when the callback returns false.
+ *  @param groupName Name of the index group whose atoms are kept.
+ *  @return Number of frames passed to the callback.
+ */
+int follow(function <bool(const Frame&)> callback, double timeout, string groupName);
+
+/** @brief Sets the number of threads used to read frames in read().
+ *  @details With more than one thread, the frame index is used to find where
+ *  each frame starts and the frames are decoded in parallel, each thread
+ *  writing to its own frames. The frames saved are exactly the same as when
+ *  reading with one thread, which is the default. Requires OpenMP.
+ *  @param n Number of threads.
+ */
+void SetNumThreads(int n);
+
+/** @brief Asks for the coordinates to be stored in huge pages.
+ *  @details The coordinates of all frames read are kept in large contiguous
+ *  blocks. For large trajectories, backing them with (transparent) huge pages
+ *  reduces TLB misses when going through the frames. Where the system does
+ *  not support it this has no effect. Off by default; applies to the next
+ *  frames read.
+ *  @param on Whether to use huge pages.
+ */
+void SetHugePages(bool on);
+
+/** @brief Keeps frames compressed in memory and decodes them when used.
+ *  @details Frames read by read() and read_next() are kept as they are in the
+ *  xtc file, which takes 10-20 times less memory than decoded coordinates. A
+ *  frame is decoded the first time its coordinates are asked for (e.g. by
+ *  GetXYZ), and the most recently used decoded frames are kept, so going
+ *  through the frames in order decodes each frame once. The time, step and
+ *  box of every frame are always available without decoding. Changes made by
+ *  CenterAtoms are lost once the frame is no longer kept decoded. Applies to
+ *  the next frames read, and only to xtc files.
+ *  @param cacheFrames Number of decoded frames kept. 0 turns this off, which
+ *  is the default.
+ */
+void SetCompressedStore(int cacheFrames);
+
+/** @brief Leaves frames in the xtc file and decodes them when used, keeping
+ *  at most a given amount of memory of decoded frames.
+ *  @details Frames read by read() and read_next() are only indexed: just the
+ *  time, step and box of each frame and where it is in the file are kept,
+ *  and the file is mapped into memory. A frame is decoded when its
+ *  coordinates are asked for (e.g. by GetXYZ), and the most recently used
+ *  decoded frames are kept up to the budget. When frames are asked for in
+ *  order, the next few are decoded ahead by a background thread. This allows
+ *  going through trajectories many times larger than memory with the usual
+ *  getters. Takes precedence over SetCompressedStore. Changes made by
+ *  CenterAtoms are lost once the frame is no longer kept decoded. Applies to
+ *  the next frames read, and only to a single xtc file.
+ *  @param bytes Memory for decoded frames in bytes. At least one frame is
+ *  always kept. 0 turns this off, which is the default.
+ */
+void SetMemoryBudget(size_t bytes);
+
+/** @brief Keeps coordinates as the integers they are stored as in the xtc
+ *  file.
+ *  @details XTC files store coordinates as integers in units of the precision
+ *  of the file (usually 0.001 nm). With this on, frames read by read() and
+ *  read_next() keep those integers, as 16 bit offsets from the lowest value in
+ *  each dimension when they fit (i.e. the atoms span less than about 65 nm at
+ *  the usual precision), which is half the memory of floats. The GetXYZ
+ *  functions convert them exactly as decoding to floats does, so the
+ *  coordinates are the same. Frames cannot be centered with CenterAtoms.
+ *  Systems of 9 atoms or fewer are stored as floats in xtc files and are kept
+ *  as floats. Applies to the next frames read, and only to xtc files.
+ *  @param on Whether to keep the coordinates quantized. Off by default.
+ */
+void SetQuantized(bool on);
+
+/** @brief Makes read() throw an exception when the file cannot be read,
+ *  instead of printing an error and ending the program.
+ *  @param on Whether read() throws. Off by default.
+ */
+void SetThrowOnError(bool on);
+
+/** @brief Decodes frames ahead of read_next in a background thread.
+ *  @details While the frames returned by one read_next call are analyzed, the
+ *  following frames are read and decoded in the background, so reading
+ *  overlaps with analysis. At most depth decoded frames are kept waiting, which
+ *  bounds the memory used; for full overlap depth should be at least the
+ *  number of frames passed to read_next. skip_next drops frames that were
+ *  already decoded, or restarts the background thread after seeking.
+ *  @param depth Maximum number of frames decoded ahead. 0 turns prefetching
+ *  off, which is the default.
+ */
+void SetPrefetch(int depth);
+
 /** @brief Reads in n simulations frames into memory and keeps the file open
  * @details Frames are saved into the frameArray object, overwriting previously
  * saved frames
@@ -154,7 +529,17 @@ int read(int b = 0, int s = 1, int e = -1);
  */
 int read_next(int n = 1);
 
+/** @brief Reads in n simulations frames, saving only the atoms of an index
+ *  group, and keeps the file open.
+ *  @details See read(int, int, int, string).
+ *  @param n Number of frames to read into memory.
+ *  @param groupName Name of the index group whose atoms are saved.
+ *  @return Number of frames actually read in.
+ */
+int read_next(int n, string groupName);
+
 /** @brief Skip n frames
+ *  @details Seeks past the frames using the frame index, so they are not read.
  *  @param n Number of frames to skip
  *  @return Number of frames actually skipped
  */
@@ -231,7 +616,8 @@ coordinates8 GetXYZ8F(int frame, string group, int atom) const; // From 8 differ
  * @param frame Number of the frame desired.
  * @return A two dimensional vector with all cartesian coordinates
  * for the system at this frame. The first dimension is the atom number.
- * The second dimension contains the X, Y, and Z positions.
+ * The second dimension contains the X, Y, and Z positions. If only an index
+ * group was read in, only the atoms in that group.
  */
 vector <coordinates> GetXYZ(int frame) const;
 
@@ -247,6 +633,56 @@ vector <coordinates> GetXYZ(int frame) const;
  */
 vector <coordinates> GetXYZ(int frame, string groupName) const;
 
+/**
+ * @brief Whether a frame has positions.
+ * @details Only frames of TRR files can be without them, since Gromacs can
+ * write positions, velocities and forces at different intervals. The
+ * coordinates of such frames are not numbers, but their velocities and forces
+ * can still be gotten.
+ * @param frame Number of the frame desired.
+ */
+bool HasPositions(int frame) const;
+
+/**
+ * @brief Gets the velocity of a specific atom in the entire system.
+ * @details Only for TRR files. The velocity is read from the mapped file when
+ * asked for, so it is never copied into memory with the frame, and the atom
+ * does not need to be in the index group that was read in.
+ * @param frame Number of the frame desired.
+ * @param atom The number corresponding with the atom in the entire system.
+ * @return Velocity of the atom in nm/ps.
+ */
+coordinates GetVelocity(int frame, int atom) const;
+
+/**
+ * @brief Gets the velocity of a specific atom in a group.
+ * @details See GetVelocity(int, int).
+ * @param frame Number of the frame desired.
+ * @param groupName Name of index group in which atom is located.
+ * @param atom The number corresponding with the atom in the index group.
+ * @return Velocity of the atom in nm/ps.
+ */
+coordinates GetVelocity(int frame, string groupName, int atom) const;
+
+/**
+ * @brief Gets the force on a specific atom in the entire system.
+ * @details Only for TRR files. See GetVelocity(int, int).
+ * @param frame Number of the frame desired.
+ * @param atom The number corresponding with the atom in the entire system.
+ * @return Force on the atom in kJ/(mol nm).
+ */
+coordinates GetForce(int frame, int atom) const;
+
+/**
+ * @brief Gets the force on a specific atom in a group.
+ * @details Only for TRR files. See GetVelocity(int, int).
+ * @param frame Number of the frame desired.
+ * @param groupName Name of index group in which atom is located.
+ * @param atom The number corresponding with the atom in the index group.
+ * @return Force on the atom in kJ/(mol nm).
+ */
+coordinates GetForce(int frame, string groupName, int atom) const;
+
 /**
  * @brief Gets the triclinic box dimensions for a frame.
  * @param frame Number of the frame desired.
@@ -0,0 +1,169 @@
+/*
+ * libgmxcpp
+ * Copyright (C) 2015 James W. Barnett <jbarnet4@tulane.edu>
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The full license is located in a text file titled "LICENSE" in the root
+ * directory of the source.
+ *
+ */
+
+/** @file
+ * @brief Header for the TrajectoryClient class
+ * */
+
+#ifndef TRAJECTORYCLIENT_H
+#define TRAJECTORYCLIENT_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include "gmxcpp/TrajectoryServer.h"
+#include "gmxcpp/coordinates.h"
+#include "gmxcpp/triclinicbox.h"
+using namespace std;
+
+/**
+ * @brief A trajectory kept open by a TrajectoryServer, with the same getters
+ * as a Trajectory.
+ *
+ * @details Connecting and opening a trajectory takes well under a
+ * millisecond once the server has opened it, so scripts that only need a few
+ * frames can be started often. Each getter asks the server for what it needs
+ * when it is not already there. The coordinates of the last frame (and index
+ * group) asked for are in memory shared with the server, and getting atoms
+ * from it reads them from there without asking again. A client must only be
+ * used by one thread at a time.
+ */
+class TrajectoryClient {
+private:
+
+/* The connection to the server, and the trajectory opened with it. */
+int fd;
+int handle;
+int natoms;
+int nframes;
+
+/* The shared memory the server writes coordinates into. */
+shared_ptr <float> region;
+
+/* What is in the shared memory: the frame (-1 for none), the index group
+ * (empty for all atoms) and the number of atoms. */
+int xyzFrame;
+string xyzGroup;
+int xyzCount;
+
+/* The last frame the step, time and box were asked for, and what they were. */
+int infoFrame;
+ServerReply info;
+
+/* Sends a request and gets its reply, throwing an exception with the message
+ * of the server if it could not be answered. */
+ServerReply request(int op, int frame, const string &text);
+
+/* Makes sure the step, time and box of a frame are known. */
+void fetchInfo(int frame);
+
+/* Makes sure the coordinates of a frame and index group are in the shared
+ * memory. */
+void fetch(int frame, const string &groupName);
+
+/* Gets the coordinates of an atom in the shared memory. */
+coordinates get(int atom) const;
+
+public:
+
+/**
+ * @brief Constructor which connects to a server and opens a trajectory.
+ * @param socketPath Path of the socket of the server.
+ * @param xtcfile Name of the trajectory, anything a Trajectory can open.
+ * @param ndxfile Name of the Gromacs index file, if index groups are used.
+ */
+TrajectoryClient(string socketPath, string xtcfile, string ndxfile = "");
+
+/**
+ * @brief Destructor, which closes the connection.
+ */
+~TrajectoryClient();
+
+TrajectoryClient(const TrajectoryClient&) = delete;
+TrajectoryClient& operator=(const TrajectoryClient&) = delete;
+
+/**
+ * @brief Gets the number of atoms in a system.
+ */
+int GetNAtoms() const;
+
+/**
+ * @brief Gets the number of atoms in an index group.
+ * @param groupName Name of the index group.
+ */
+int GetNAtoms(string groupName);
+
+/**
+ * @brief Gets the number of frames in the trajectory.
+ */
+int GetNFrames() const;
+
+/**
+ * @brief Gets the time of a frame in picoseconds.
+ * @param frame Frame number.
+ */
+float GetTime(int frame);
+
+/**
+ * @brief Gets the step of a frame.
+ * @param frame Frame number.
+ */
+int GetStep(int frame);
+
+/**
+ * @brief Gets the box of a frame.
+ * @param frame Frame number.
+ */
+triclinicbox GetBox(int frame);
+
+/**
+ * @brief Gets the coordinates of an atom in the system.
+ * @param frame Frame number.
+ * @param atom Atom number in the system.
+ */
+coordinates GetXYZ(int frame, int atom);
+
+/**
+ * @brief Gets the coordinates of an atom in an index group.
+ * @param frame Frame number.
+ * @param groupName Name of the index group.
+ * @param atom Atom number in the index group.
+ */
+coordinates GetXYZ(int frame, string groupName, int atom);
+
+/**
+ * @brief Gets the coordinates of all atoms in the system.
+ * @param frame Frame number.
+ */
+vector <coordinates> GetXYZ(int frame);
+
+/**
+ * @brief Gets the coordinates of all atoms in an index group.
+ * @param frame Frame number.
+ * @param groupName Name of the index group.
+ */
+vector <coordinates> GetXYZ(int frame, string groupName);
+
+};
+
+#endif
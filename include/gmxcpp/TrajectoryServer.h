@@ -0,0 +1,157 @@
+/*
+ * libgmxcpp
+ * Copyright (C) 2015 James W. Barnett <jbarnet4@tulane.edu>
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The full license is located in a text file titled "LICENSE" in the root
+ * directory of the source.
+ *
+ */
+
+/** @file
+ * @brief Header for the TrajectoryServer class
+ * */
+
+#ifndef TRAJECTORYSERVER_H
+#define TRAJECTORYSERVER_H
+
+#include <stdint.h>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdexcept>
+#include "gmxcpp/Trajectory.h"
+using namespace std;
+
+/**
+ * @brief What a TrajectoryClient asks a TrajectoryServer for.
+ * @details Each request is sent as this header followed by length bytes of
+ * text: the trajectory and index file names separated by a null character
+ * for Open, or the name of an index group (empty for all atoms) otherwise.
+ */
+struct ServerRequest {
+    enum Op { Open = 1, Info = 2, Coordinates = 3, GroupSize = 4 };
+    int32_t op;
+    int32_t handle;
+    int32_t frame;
+    int32_t length;
+};
+
+/**
+ * @brief What a TrajectoryServer answers.
+ * @details For Coordinates, count atoms are in the shared memory of the
+ * connection as floats (x, y, z for each atom). A new shared memory object is
+ * passed along with the reply whenever the old one is too small. When status
+ * is not 0, length bytes of error message follow.
+ */
+struct ServerReply {
+    int32_t status;
+    int32_t handle;
+    int32_t natoms;
+    int32_t nframes;
+    int32_t step;
+    float time;
+    float box[DIM][DIM];
+    int32_t count;
+    int32_t length;
+};
+
+/**
+ * @brief Serves frames of trajectories to other processes on the same machine
+ * over a Unix domain socket.
+ *
+ * @details Opening a trajectory and decoding frames costs much more than a
+ * short script or a notebook cell does with them. A server keeps each
+ * trajectory it is asked for open, with every frame indexed and the recently
+ * used frames decoded, so a TrajectoryClient only pays for sending the frames
+ * it asks for. The coordinates are written into shared memory belonging to
+ * the connection, so they are never copied through the socket. Each
+ * connection is served by its own thread.
+ */
+class TrajectoryServer {
+private:
+
+/* The path of the socket, and its file descriptor. */
+string socketPath;
+int listener;
+
+/* Both ends of a pipe written to by Stop(), to wake up Run(). */
+int wakeup[2];
+
+/* Memory for decoded frames of each trajectory when it is an xtc file. */
+size_t memoryBudget;
+
+/* A trajectory, read in by the first connection to ask for it while the
+ * others asking for it wait on its lock. */
+struct Opened {
+    mutex lock;
+    shared_ptr <Trajectory> trj;
+};
+
+/* Trajectories asked for, by trajectory and index file names. */
+mutex opening;
+map <pair <string, string>, shared_ptr <Opened> > trajectories;
+
+/* Connections being served, each by its own thread, and the number of those
+ * threads still running. */
+mutex lock;
+vector <int> connections;
+int active;
+condition_variable idle;
+
+/* Gets a trajectory, opening and reading it in the first time. */
+shared_ptr <Trajectory> open(const string &xtcfile, const string &ndxfile);
+
+/* Answers requests on a connection until it is closed. */
+void serve(int fd);
+
+public:
+
+/**
+ * @brief Constructor which creates the socket.
+ * @details A socket left by a server that is no longer running is replaced.
+ * @param socketPath Path of the Unix domain socket.
+ * @param memoryBudget Bytes of decoded frames kept for each xtc file. The
+ * compressed frames are left in the file. 0 reads in every frame instead,
+ * which is faster to serve but needs all of them to fit in memory.
+ */
+TrajectoryServer(string socketPath, size_t memoryBudget = 1 << 30);
+
+/**
+ * @brief Destructor, which removes the socket.
+ */
+~TrajectoryServer();
+
+TrajectoryServer(const TrajectoryServer&) = delete;
+TrajectoryServer& operator=(const TrajectoryServer&) = delete;
+
+/**
+ * @brief Serves clients until Stop() is called.
+ */
+void Run();
+
+/**
+ * @brief Makes Run() return once every connection is closed. Can be called
+ * from another thread or a signal handler.
+ */
+void Stop();
+
+};
+
+#endif
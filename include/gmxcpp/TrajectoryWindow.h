@@ -0,0 +1,200 @@
+/*
+ * libgmxcpp
+ * Copyright (C) 2015 James W. Barnett <jbarnet4@tulane.edu>
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The full license is located in a text file titled "LICENSE" in the root
+ * directory of the source.
+ *
+ */
+
+
+/** @file
+ * @brief Header for the TrajectoryWindow class
+ * */
+
+#ifndef TRAJECTORYWINDOW_H
+#define TRAJECTORYWINDOW_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "gmxcpp/Frame.h"
+#include "gmxcpp/FrameIndex.h"
+#include "gmxcpp/coordinates.h"
+#include "gmxcpp/coordinates8.h"
+#include "gmxcpp/triclinicbox.h"
+#include "xdrfile.h"
+#include "xdrfile_xtc.h"
+using namespace std;
+
+/**
+ * @brief The last few frames of an XTC file, kept while going forward through
+ * it.
+ *
+ * @details Returned by Trajectory::window. Analyses over a lag (mean squared
+ * displacement, residence times, GetXYZ8F) need frames t to t+L at the same
+ * time. The window keeps the last L frames read in a ring buffer: Advance()
+ * puts the next frame in place of the oldest one, so memory use stays at L + 1
+ * frames however long the trajectory is, and every frame is decoded once.
+ * Frames are gotten by their frame number in the file, as with a Trajectory,
+ * as long as they are still in the window. The window has its own handle on
+ * the XTC file and uses the frame index of the Trajectory it came from, so it
+ * must not outlive it.
+ */
+class TrajectoryWindow {
+private:
+
+/* Handle on the xtc file owned by this window. */
+XDRFILE *xd;
+
+/* Number of atoms in the system. */
+int natoms;
+
+/* Atoms (numbered in the system) kept in each frame, or empty for all. */
+vector <int> atoms;
+
+/* Number of frames kept. */
+int length;
+
+/* Frame number of the oldest and newest frames kept; last is first - 1 when
+ * no frame has been read. */
+int first;
+int last;
+
+/* Frame number of the next frame in the file. */
+int position;
+
+/* The frames kept, frame n being at n % length, and their coordinates. */
+vector <Frame> frames;
+vector <shared_ptr <float> > storage;
+
+/* Coordinates of the next frame are decoded here. */
+shared_ptr <float> spare;
+
+/* The whole system is decoded here when only some atoms are kept. */
+vector <float> scratch;
+
+/* Gets a frame, checking it is in the window. */
+const Frame& at(int frame) const;
+
+public:
+
+/**
+ * @brief Opens a window over an XTC file.
+ * @param xtcfile Name of the Gromacs XTC file.
+ * @param natoms Number of atoms in the system.
+ * @param atoms Atoms (numbered in the system) kept in each frame, in this
+ * order. If empty, all atoms are kept.
+ * @param frameIndex Frame index used to go to frame b. NULL to read through
+ * the frames before it instead.
+ * @param length Number of frames kept.
+ * @param b First frame read.
+ */
+TrajectoryWindow(string xtcfile, int natoms, const vector <int> &atoms,
+                 const FrameIndex *frameIndex, int length, int b);
+
+/** @brief Takes over the file handle of other. */
+TrajectoryWindow(TrajectoryWindow &&other) noexcept;
+
+TrajectoryWindow(const TrajectoryWindow &other) = delete;
+
+TrajectoryWindow& operator=(const TrajectoryWindow &other) = delete;
+
+/** @brief Closes the file. */
+~TrajectoryWindow();
+
+/**
+ * @brief Reads the next frame into the window, in place of the oldest frame
+ * if the window is full.
+ * @details A copy of the oldest frame made before (e.g. with GetFrame) stays
+ * valid; its coordinates are then not reused.
+ * @return Whether there was a next frame.
+ */
+bool Advance();
+
+/**
+ * @brief Reads the next n frames into the window.
+ * @param n Number of frames.
+ * @return Number of frames read, less than n at the end of the file.
+ */
+int Advance(int n);
+
+/**
+ * @brief Gets the frame number of the oldest frame in the window.
+ */
+int GetFirst() const;
+
+/**
+ * @brief Gets the frame number of the newest frame in the window, or
+ * GetFirst() - 1 if no frame has been read.
+ */
+int GetLast() const;
+
+/**
+ * @brief Gets the number of frames kept when the window is full.
+ */
+int GetLength() const;
+
+/**
+ * @brief Whether a frame is in the window.
+ * @param frame Frame number in the file.
+ */
+bool Contains(int frame) const;
+
+/**
+ * @brief Gets a frame in the window.
+ * @param frame Frame number in the file.
+ */
+const Frame& GetFrame(int frame) const;
+
+/**
+ * @brief Gets the coordinates of an atom in a frame in the window.
+ * @param frame Frame number in the file.
+ * @param atom Atom number in the system, or in the group if the window only
+ * keeps the atoms of an index group.
+ */
+coordinates GetXYZ(int frame, int atom) const;
+
+/**
+ * @brief Gets the coordinates of an atom in 8 frames in a row, which must all
+ * be in the window.
+ * @param frame Frame number in the file of the first of the frames.
+ * @param atom Atom number in the system, or in the group if the window only
+ * keeps the atoms of an index group.
+ */
+coordinates8 GetXYZ8F(int frame, int atom) const;
+
+/**
+ * @brief Gets the box of a frame in the window.
+ * @param frame Frame number in the file.
+ */
+triclinicbox GetBox(int frame) const;
+
+/**
+ * @brief Gets the step of a frame in the window.
+ * @param frame Frame number in the file.
+ */
+int GetStep(int frame) const;
+
+/**
+ * @brief Gets the time of a frame in the window in picoseconds.
+ * @param frame Frame number in the file.
+ */
+float GetTime(int frame) const;
+
+};
+
+#endif
@@ -0,0 +1,176 @@
+/*
+ * libgmxcpp
+ * Copyright (C) 2015 James W. Barnett <jbarnet4@tulane.edu>
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The full license is located in a text file titled "LICENSE" in the root
+ * directory of the source.
+ *
+ */
+
+/** @file
+ * @brief Header for the TrrFile class
+ * */
+
+#ifndef TRRFILE_H
+#define TRRFILE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include "gmxcpp/coordinates.h"
+#include "xdrfile.h"
+using namespace std;
+
+/**
+ * @brief A Gromacs TRR file mapped into memory.
+ *
+ * @details TRR files are uncompressed XDR, so nothing has to be decoded: the
+ * whole file is mapped read-only and only the frame headers are read when it
+ * is opened, recording where the box, positions, velocities and forces of each
+ * frame start. Values are converted from XDR (big-endian) byte order, and from
+ * double to single precision for double precision files, only when they are
+ * asked for, so the pages of a frame are only read from disk once something
+ * in it is used. A truncated last frame is ignored.
+ */
+class TrrFile {
+private:
+
+/* Where the parts of a frame start in the file, -1 if not in the frame. */
+struct TrrFrame {
+    int step;
+    double time;
+    double lambda;
+    bool dbl;
+    int64_t box;
+    int64_t x;
+    int64_t v;
+    int64_t f;
+};
+
+/* The name of the trr file. */
+string trrfile;
+
+/* Number of atoms in the system. */
+int natoms;
+
+/* The mapped file and its size in bytes. */
+const unsigned char *data;
+int64_t size;
+
+/* Header of each complete frame. */
+vector <TrrFrame> frames;
+
+/* Reads the header of the frame at offset. Returns the offset of the next
+ * frame, or -1 if there is no complete frame there. */
+int64_t scan(int64_t offset);
+
+/* Converts the three values of an atom starting at offset. */
+coordinates get(int64_t offset, bool dbl, int atom) const;
+
+/* Gets the header of a frame, checking the frame number. */
+const TrrFrame& frame(int frame) const;
+
+public:
+
+/**
+ * @brief Constructor which maps a TRR file and reads its frame headers.
+ * @param trrfile Name of the Gromacs TRR file.
+ */
+TrrFile(string trrfile);
+
+~TrrFile();
+
+TrrFile(const TrrFile&) = delete;
+TrrFile& operator=(const TrrFile&) = delete;
+
+/**
+ * @brief Gets the number of complete frames in the file.
+ */
+int GetNFrames() const;
+
+/**
+ * @brief Gets the number of atoms in the system.
+ */
+int GetNAtoms() const;
+
+/**
+ * @brief Gets the step of a frame.
+ * @param frame Frame number in the file.
+ */
+int GetStep(int frame) const;
+
+/**
+ * @brief Gets the time of a frame in picoseconds.
+ * @param frame Frame number in the file.
+ */
+float GetTime(int frame) const;
+
+/**
+ * @brief Gets the value of lambda of a frame.
+ * @param frame Frame number in the file.
+ */
+float GetLambda(int frame) const;
+
+/**
+ * @brief Gets the box of a frame, all zeros if the frame has none.
+ * @param frame Frame number in the file.
+ * @param box Where the box is written.
+ */
+void GetBox(int frame, matrix box) const;
+
+/** @brief Whether a frame has positions. */
+bool HasPositions(int frame) const;
+
+/** @brief Whether a frame has velocities. */
+bool HasVelocities(int frame) const;
+
+/** @brief Whether a frame has forces. */
+bool HasForces(int frame) const;
+
+/**
+ * @brief Gets the position of an atom in nm.
+ * @param frame Frame number in the file.
+ * @param atom Atom number in the system.
+ */
+coordinates GetPosition(int frame, int atom) const;
+
+/**
+ * @brief Gets the velocity of an atom in nm/ps.
+ * @param frame Frame number in the file.
+ * @param atom Atom number in the system.
+ */
+coordinates GetVelocity(int frame, int atom) const;
+
+/**
+ * @brief Gets the force on an atom in kJ/(mol nm).
+ * @param frame Frame number in the file.
+ * @param atom Atom number in the system.
+ */
+coordinates GetForce(int frame, int atom) const;
+
+/**
+ * @brief Converts the positions of some atoms of a frame.
+ * @param frame Frame number in the file.
+ * @param atoms Atom numbers in the system, in the order they are written to
+ * dest. If empty, all atoms are written.
+ * @param dest Where the positions are written.
+ */
+void GetPositions(int frame, const vector <int> &atoms, rvec *dest) const;
+
+};
+
+#endif
@@ -0,0 +1,175 @@
+/*
+ * libgmxcpp
+ * Copyright (C) 2015 James W. Barnett <jbarnet4@tulane.edu>
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The full license is located in a text file titled "LICENSE" in the root
+ * directory of the source.
+ *
+ */
+
+
+/** @file
+ * @brief Header for the XtcWriter class
+ * */
+
+#ifndef XTCWRITER_H
+#define XTCWRITER_H
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdexcept>
+#include "gmxcpp/Frame.h"
+#include "gmxcpp/Trajectory.h"
+#include "gmxcpp/coordinates.h"
+#include "gmxcpp/triclinicbox.h"
+#include "xdrfile.h"
+using namespace std;
+
+/**
+ * @brief Writes frames to an XTC file, compressing them on several threads.
+ *
+ * @details Compressing a frame takes several times as long as decompressing
+ * it, so writing with one thread would be much slower than reading. Frames
+ * passed to Write() are copied and compressed by a pool of threads, each into
+ * its own buffer. A separate thread writes the compressed frames to the file
+ * in the order they were passed, so the file is the same as one written by
+ * write_xtc one frame at a time. Write() only waits when many frames are
+ * waiting to be compressed, which keeps the memory used bounded.
+ */
+class XtcWriter {
+private:
+
+/* A frame waiting to be compressed, and then to be written. */
+struct Job {
+    int step;
+    float time;
+    matrix box;
+    vector <float> x;
+    char *data;
+    size_t size;
+    bool compressed;
+    bool ok;
+};
+
+/* The name of the xtc file. */
+string xtcfile;
+
+/* The file being written. */
+FILE *fp;
+
+/* Precision the coordinates are saved with. */
+float prec;
+
+/* Number of atoms in each frame, set by the first frame. */
+int natoms;
+
+/* Maximum number of frames passed to Write() and not yet written. */
+size_t maxPending;
+
+/* Frames by the order they were passed to Write(), from the first not yet
+ * written. Jobs not yet taken by a compressing thread are from next on. */
+map <long, Job> jobs;
+long next;
+long submitted;
+long written;
+
+/* Set when Close() is called, and when a frame could not be compressed or
+ * written. */
+bool closing;
+bool failed;
+
+mutex lock;
+condition_variable changed;
+vector <thread> compressors;
+thread writer;
+
+/* Compresses frames until closing. */
+void compress();
+
+/* Writes compressed frames in order until closing and all are written. */
+void write();
+
+public:
+
+/**
+ * @brief Constructor which creates (or overwrites) an XTC file.
+ * @param xtcfile Name of the XTC file to be written.
+ * @param nthreads Number of threads compressing frames.
+ * @param prec Precision the coordinates are saved with, 1000 being 0.001 nm.
+ */
+XtcWriter(string xtcfile, int nthreads = 1, float prec = 1000.0);
+
+/**
+ * @brief Destructor, which closes the file if Close() was not called.
+ */
+~XtcWriter();
+
+XtcWriter(const XtcWriter&) = delete;
+XtcWriter& operator=(const XtcWriter&) = delete;
+
+/**
+ * @brief Adds a frame to the end of the file.
+ * @details The coordinates are copied, so they can be changed once this
+ * returns.
+ * @param step Simulation step of the frame.
+ * @param time Simulation time of the frame in picoseconds.
+ * @param box Box of the frame.
+ * @param x Coordinates of the atoms in the frame. Every frame of a file has
+ * the same number of atoms.
+ */
+void Write(int step, float time, triclinicbox box, const vector <coordinates> &x);
+
+/**
+ * @brief Adds a frame to the end of the file.
+ * @param frame The frame, with all atoms.
+ */
+void Write(const Frame &frame);
+
+/**
+ * @brief Adds a frame of a Trajectory to the end of the file.
+ * @param trj The Trajectory the frame was read in by.
+ * @param frame Frame number in the Trajectory.
+ */
+void Write(const Trajectory &trj, int frame);
+
+/**
+ * @brief Adds the atoms of an index group in a frame of a Trajectory to the
+ * end of the file.
+ * @param trj The Trajectory the frame was read in by.
+ * @param frame Frame number in the Trajectory.
+ * @param groupName Name of the index group whose atoms are written.
+ */
+void Write(const Trajectory &trj, int frame, string groupName);
+
+/**
+ * @brief Writes the frames still being compressed and closes the file.
+ * @details Throws an exception if any frame could not be written.
+ */
+void Close();
+
+/**
+ * @brief Gets the number of frames passed to Write().
+ */
+int GetNFrames() const;
+
+};
+
+#endif
@@ -44,10 +44,10 @@
  *    three decimals guaranteed accuracy, and reduces the filesize to 1/10th
  *    of normal binary data.
  *
- * We do not support getting or setting positions in XDR files, since it can
- * break in horrible ways for large (64-bit) files, resulting in silent data
- * corruption. Note that it works great to open/read/write 64-bit files if
- * your system supports it; it is just the random access we cannot trust!
+ * Positions in XDR files can be read and set with xdrfile_tell() and
+ * xdrfile_seek(). All positions, including those of the internal XDR
+ * getpos/setpos routines, are 64-bit offsets (ftello/fseeko), so files larger
+ * than 4 GB can be read on 32-bit systems too.
  *
  * We also provide wrapper routines so this module can be used from FORTRAN -
  * see the file xdrfile_fortran.txt in the Gromacs distribution for
@@ -58,6 +58,9 @@
 #ifndef _XDRFILE_H_
 #define _XDRFILE_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -78,6 +81,9 @@ extern "C"
  */
 typedef struct XDRFILE XDRFILE;
 
+/*! \brief Expected access pattern, see xdrfile_advise() */
+enum { xdrNORMAL, xdrSEQUENTIAL, xdrRANDOM };
+
 enum { exdrOK, exdrHEADER, exdrSTRING, exdrDOUBLE,
        exdrINT, exdrFLOAT, exdrUINT, exdr3DX, exdrCLOSE, exdrMAGIC,
        exdrNOMEM, exdrENDOFFILE, exdrFILENOTFOUND, exdrNR };
@@ -97,7 +103,10 @@ typedef int mybool;
  *  be used with routines defined in this header.
  *
  *  \param path  Full or relative path (including name) of the file
- *  \param mode  "r" for reading, "w" for writing, "a" for append.
+ *  \param mode  "r" for reading, "w" for writing, "a" for append. "rm" reads
+ *               the file through a read-only memory map instead of stdio, so
+ *               data is decoded straight from the page cache. If the file
+ *               cannot be mapped it is read with stdio as for "r".
  *
  *  \return Pointer to abstract xdr file datatype, or NULL if an error occurs.
  *
@@ -106,6 +115,39 @@ XDRFILE *
 xdrfile_open(const char *path, const char *mode);
 
 
+/*! \brief Open a buffer in memory holding XDR data for reading
+ *
+ *  The buffer is read exactly like a file opened with "rm", e.g. to decode
+ *  frames kept in memory. It is not copied, so it must stay valid until the
+ *  handle is closed, and it is not freed by xdrfile_close().
+ *
+ *  \param data  Start of the XDR data
+ *  \param size  Length of the data in bytes
+ *
+ *  \return Pointer to abstract xdr file datatype, or NULL if an error occurs
+ *          or memory-mapped reading is not supported.
+ */
+XDRFILE *
+xdrfile_open_memory(const void *data, int64_t size);
+
+
+/*! \brief Open a buffer in memory for writing XDR data
+ *
+ *  Data is written exactly like to a file opened with "w", e.g. to compress
+ *  frames before they are written to a file. The buffer grows as needed. Once
+ *  the handle is closed, *data and *size are the buffer and the number of
+ *  bytes written; the buffer must then be freed with free().
+ *
+ *  \param data  Where the start of the buffer is put
+ *  \param size  Where the number of bytes written is put
+ *
+ *  \return Pointer to abstract xdr file datatype, or NULL if an error occurs
+ *          or writing to memory is not supported.
+ */
+XDRFILE *
+xdrfile_open_memstream(char **data, size_t *size);
+
+
 /*! \brief Close a previously opened portable binary file, just like fclose()
  *
  *  Use this routine much like calls to the standard library function
@@ -121,6 +163,47 @@ xdrfile_close(XDRFILE *xfp);
 
 
 
+/*! \brief Get the current position in a portable binary file, like ftello()
+ *
+ *  \param xfp  Handle to portable binary file, created with xdrfile_open()
+ *  \return     Offset in bytes from the start of the file, or -1 on error.
+ */
+int64_t
+xdrfile_tell(XDRFILE *xfp);
+
+
+
+/*! \brief Set the position in a portable binary file, like fseeko()
+ *
+ *  Only use positions previously returned by xdrfile_tell() or known to be
+ *  at the start of an XDR item, otherwise the following reads return garbage.
+ *
+ *  \param xfp     Handle to portable binary file, created with xdrfile_open()
+ *  \param pos     Offset in bytes relative to \a whence
+ *  \param whence  SEEK_SET, SEEK_CUR or SEEK_END
+ *  \return        0 on success, non-zero on error.
+ */
+int
+xdrfile_seek(XDRFILE *xfp, int64_t pos, int whence);
+
+
+
+
+/*! \brief Tell the system how a memory-mapped file will be read
+ *
+ *  Use xdrSEQUENTIAL (the default) when streaming through the file, so that
+ *  pages are read ahead, and xdrRANDOM when seeking to individual frames.
+ *  This does nothing for files that are not memory-mapped.
+ *
+ *  \param xfp     Handle to portable binary file, created with xdrfile_open()
+ *  \param advice  xdrNORMAL, xdrSEQUENTIAL or xdrRANDOM
+ *  \return        0 on success, non-zero on error.
+ */
+int
+xdrfile_advise(XDRFILE *xfp, int advice);
+
+
+
 
 /*! \brief Read one or more \a char type variable(s)
  *
@@ -484,6 +567,73 @@ xdrfile_decompress_coord_float(float *ptr, int *ncoord, float *precision, XDRFIL
 
 
 
+/*! \brief Decompress coordinates from XDR file into separate x, y and z arrays
+ *
+ *  Same as xdrfile_decompress_coord_float(), but the coordinates are written
+ *  as a structure of arrays, which SIMD code can load directly. When
+ *  compiled with AVX the integers are converted 8 atoms at a time.
+ *
+ *  \param x          Pointer to x coordinates (length>= ncoord)
+ *  \param y          Pointer to y coordinates (length>= ncoord)
+ *  \param z          Pointer to z coordinates (length>= ncoord)
+ *  \param ncoord     Max number of coordinate triplets to read on input, actual
+ *                    number of coordinate triplets read on return.
+ *  \param precision  The precision used in the previous compression will be
+ *                    written to this variable on return.
+ *  \param xfp        Handle to portably binary file
+ *
+ *  \return           Number of coordinate triplets read. If this is negative,
+ *                    an error occured.
+ */
+int
+xdrfile_decompress_coord_float_soa(float *x, float *y, float *z, int *ncoord,
+                                   float *precision, XDRFILE *xfp);
+
+
+
+
+/*! \brief Decompress coordinates from XDR file to the integers they are stored as
+ *
+ *  Same as xdrfile_decompress_coord_float(), but without converting the
+ *  integers back to coordinates. xdrfile_decompress_coord_float() computes
+ *  coordinate i as ptr[i] multiplied by the float 1/precision, so doing the
+ *  same gives exactly the same value. Sets of 3 atoms or less (9 or fewer
+ *  coordinates) are stored as floats, so there are no integers and this
+ *  returns an error.
+ *
+ *  \param ptr        Pointer to integers (length>= 3*ncoord)
+ *  \param ncoord     Max number of coordinate triplets to read on input, actual
+ *                    number of coordinate triplets read on return.
+ *  \param precision  The precision used in the previous compression will be
+ *                    written to this variable on return.
+ *  \param xfp        Handle to portably binary file
+ *
+ *  \return           Number of coordinate triplets read. If this is negative,
+ *                    an error occured.
+ */
+int
+xdrfile_decompress_coord_int(int *ptr, int *ncoord, float *precision, XDRFILE *xfp);
+
+
+
+
+/*! \brief Skip compressed coordinates in an XDR file without decompressing
+ *
+ *  This routine reads only the number of coordinates and the length of the
+ *  compressed data (which is stored right before it), and then moves the file
+ *  position past the data. It is much faster than decompressing coordinates
+ *  that are thrown away.
+ *  \param ncoord     Number of coordinate triplets skipped on return.
+ *  \param xfp        Handle to portably binary file
+ *  \return           Number of coordinate triplets skipped. If this is
+ *                    negative, an error occured or the data was truncated.
+ */
+int
+xdrfile_skip_coord_float(int *ncoord, XDRFILE *xfp);
+
+
+
+
 /*! \brief Compress coordiates in a double array to XDR file
  *
  *  This routine will perform \a lossy compression on the three-dimensional
@@ -30,6 +30,18 @@ extern int read_xtc_natoms(char *fn, int *natoms);
 /* Read one frame of an open xtc file */
 extern int read_xtc(XDRFILE *xd, int natoms, int *step, float *time, matrix box, rvec *x, float *prec);
 
+/* Read one frame of an open xtc file, with the coordinates in separate x, y and z arrays */
+extern int read_xtc_soa(XDRFILE *xd, int natoms, int *step, float *time, matrix box, float *x, float *y, float *z, float *prec);
+
+/* Read one frame of an open xtc file, with the coordinates as the integers
+ * they are stored as (coordinate = integer / prec). Fails for 9 atoms or
+ * fewer, which are not stored as integers */
+extern int read_xtc_int(XDRFILE *xd, int natoms, int *step, float *time, matrix box, int *x, float *prec);
+
+/* Read the header and box of one frame of an open xtc file, and skip past its
+ * coordinates without decompressing them */
+extern int skip_xtc(XDRFILE *xd, int natoms, int *step, float *time, matrix box);
+
 /* Write a frame to xtc file */
 extern int write_xtc(XDRFILE *xd, int natoms, int step, float time, matrix box, rvec *x, float prec);
 
@@ -29,51 +29,15 @@
  */
 
 #include "gmxcpp/Frame.h"
+#include <limits.h>
+#include <stdexcept>
 #include <stdio.h>
 #include <string.h>
 
-Frame::Frame() { }
-
-Frame::~Frame()
-{
-    delete[] this->x;
-}
-
-Frame::Frame(const Frame& other)
-{
-    x = new rvec[other.natoms];
-    memcpy(x, other.x, sizeof(float)*other.natoms*3.0);
-    natoms = other.natoms;
-    step = other.step;
-    time = other.time;
-    box[X][X] = other.box[X][X];
-    box[X][Y] = other.box[X][Y];
-    box[X][Z] = other.box[X][Z];
-    box[Y][X] = other.box[Y][X];
-    box[Y][Y] = other.box[Y][Y];
-    box[Y][Z] = other.box[Y][Z];
-    box[Z][X] = other.box[Z][X];
-    box[Z][Y] = other.box[Z][Y];
-    box[Z][Z] = other.box[Z][Z];
-}
-
-Frame& Frame::operator=(const Frame& other ) 
+Frame::Frame()
 {
-    x = new rvec[other.natoms];
-    memcpy(x, other.x, sizeof(float)*other.natoms*3.0);
-    natoms = other.natoms;
-    step = other.step;
-    time = other.time;
-    box[X][X] = other.box[X][X];
-    box[X][Y] = other.box[X][Y];
-    box[X][Z] = other.box[X][Z];
-    box[Y][X] = other.box[Y][X];
-    box[Y][Y] = other.box[Y][Y];
-    box[Y][Z] = other.box[Y][Z];
-    box[Z][X] = other.box[Z][X];
-    box[Z][Y] = other.box[Z][Y];
-    box[Z][Z] = other.box[Z][Z];
-    return *this;
+    this->natoms = 0;
+    this->x = NULL;
 }
 
 Frame::Frame(int &step, float &time, matrix &box, rvec *x, int &natoms)
@@ -90,11 +54,124 @@ Frame::Frame(int &step, float &time, matrix &box, rvec *x, int &natoms)
     this->box[Z][Y] = box[Z][Y];
     this->box[Z][Z] = box[Z][Z];
     this->natoms = natoms;
-    this->x = new rvec[natoms];
+    this->storage = shared_ptr <float> (new float[natoms * DIM], default_delete<float[]>());
+    this->x = (rvec*) storage.get();
     memcpy(this->x, x, sizeof(float)*natoms*3.0);
     return;
 }
 
+Frame::Frame(int &step, float &time, matrix &box, shared_ptr <float> x, int natoms)
+{
+    this->step = step;
+    this->time = time;
+    memcpy(this->box, box, sizeof(matrix));
+    this->natoms = natoms;
+    this->storage = x;
+    this->x = (rvec*) storage.get();
+    return;
+}
+
+Frame::Frame(int &step, float &time, matrix &box, rvec *x, const vector <int> &atoms)
+{
+    this->step = step;
+    this->time = time;
+    memcpy(this->box, box, sizeof(matrix));
+    this->natoms = atoms.size();
+    this->storage = shared_ptr <float> (new float[this->natoms * DIM], default_delete<float[]>());
+    this->x = (rvec*) storage.get();
+    for (int i = 0; i < this->natoms; ++i)
+    {
+        this->x[i][X] = x[atoms[i]][X];
+        this->x[i][Y] = x[atoms[i]][Y];
+        this->x[i][Z] = x[atoms[i]][Z];
+    }
+    return;
+}
+
+Frame::Frame(const Frame &frame, shared_ptr <float> x)
+{
+    this->step = frame.step;
+    this->time = frame.time;
+    memcpy(this->box, frame.box, sizeof(matrix));
+    this->natoms = frame.natoms;
+    this->storage = x;
+    this->x = (rvec*) storage.get();
+    return;
+}
+
+Frame::Frame(int &step, float &time, matrix &box, const int *x, float prec, int natoms, const vector <int> &atoms)
+{
+    this->step = step;
+    this->time = time;
+    memcpy(this->box, box, sizeof(matrix));
+    this->natoms = atoms.empty() ? natoms : atoms.size();
+    this->x = NULL;
+    /* Same as in xdrfile, so converting gives the same floats. */
+    this->invprec = 1.0 / prec;
+
+    int lo[DIM] = { INT_MAX, INT_MAX, INT_MAX };
+    int hi[DIM] = { INT_MIN, INT_MIN, INT_MIN };
+    for (int i = 0; i < this->natoms; ++i)
+    {
+        const int *xi = x + (atoms.empty() ? i : atoms[i]) * DIM;
+        for (int d = 0; d < DIM; ++d)
+        {
+            lo[d] = min(lo[d], xi[d]);
+            hi[d] = max(hi[d], xi[d]);
+        }
+    }
+
+    bool fits = true;
+    for (int d = 0; d < DIM; ++d)
+    {
+        fits = fits && (int64_t) hi[d] - lo[d] <= UINT16_MAX;
+    }
+
+    const int n = this->natoms * DIM;
+    if (fits)
+    {
+        uint16_t *q = new uint16_t[n];
+        this->storage = shared_ptr <void> (q, default_delete<uint16_t[]>());
+        this->q16 = q;
+        memcpy(this->qmin, lo, sizeof(qmin));
+        for (int i = 0; i < this->natoms; ++i)
+        {
+            const int *xi = x + (atoms.empty() ? i : atoms[i]) * DIM;
+            for (int d = 0; d < DIM; ++d)
+            {
+                q[i * DIM + d] = xi[d] - lo[d];
+            }
+        }
+    }
+    else
+    {
+        int32_t *q = new int32_t[n];
+        this->storage = shared_ptr <void> (q, default_delete<int32_t[]>());
+        this->q32 = q;
+        memset(this->qmin, 0, sizeof(qmin));
+        for (int i = 0; i < this->natoms; ++i)
+        {
+            const int *xi = x + (atoms.empty() ? i : atoms[i]) * DIM;
+            memcpy(q + i * DIM, xi, sizeof(int32_t) * DIM);
+        }
+    }
+    return;
+}
+
+inline const float* Frame::xyz(int atom, rvec tmp) const
+{
+    if (x != NULL)
+    {
+        return x[atom];
+    }
+    for (int d = 0; d < DIM; ++d)
+    {
+        const int q = (q16 != NULL) ? q16[atom * DIM + d] + qmin[d] : q32[atom * DIM + d];
+        tmp[d] = q * invprec;
+    }
+    return tmp;
+}
+
 float Frame::GetTime() const
 {
     return time;
@@ -107,30 +184,36 @@ int Frame::GetStep() const
 
 coordinates Frame::GetXYZ(int atom) const
 {
-    return (coordinates (x[atom][X], x[atom][Y], x[atom][Z]));
+    rvec tmp;
+    const float *p = xyz(atom, tmp);
+    return (coordinates (p[X], p[Y], p[Z]));
 }
 
 vector <coordinates> Frame::GetXYZ() const
 {
-    vector <coordinates> xyz(natoms);
+    vector <coordinates> all(natoms);
+    rvec tmp;
     for (int atom = 0; atom < natoms; ++atom) 
     {
-        xyz[atom] = { this->x[atom][X], this->x[atom][Y], this->x[atom][Z] };
+        const float *p = xyz(atom, tmp);
+        all[atom] = { p[X], p[Y], p[Z] };
     }
-    return xyz;
+    return all;
 }
 
 vector <coordinates> Frame::GetXYZ(Index index, string group) const
 {
     int location;
     const int grp_size = index.GetGroupSize(group);
-    vector <coordinates> xyz(grp_size);
+    vector <coordinates> all(grp_size);
+    rvec tmp;
     for (int atom = 0; atom < grp_size; ++atom) 
     {
         location = index.GetLocation(group, atom);
-        xyz[atom] = { this->x[location][X], this->x[location][Y], this->x[location][Z] };
+        const float *p = xyz(location, tmp);
+        all[atom] = { p[X], p[Y], p[Z] };
     }
-    return xyz;
+    return all;
 }
 
 triclinicbox Frame::GetBox() const
@@ -158,6 +241,10 @@ double Frame::GetBoxVolume() const
 
 void Frame::CenterAtoms() const
 {
+    if (x == NULL)
+    {
+        throw runtime_error("Cannot center the atoms of a frame stored quantized.");
+    }
     vector <coordinates> xyz = GetXYZ();
     cubicbox b = GetCubicBox();
     do_center_group(xyz, b);
@@ -174,42 +261,47 @@ void Frame::CenterAtoms() const
 #ifdef AVX
 coordinates4 Frame::GetXYZ4(int atom) const
 {
-    return (coordinates4 (x[atom][X], x[atom][Y], x[atom][Z],
-                          x[atom+1][X], x[atom+1][Y], x[atom+1][Z],
-                          x[atom+2][X], x[atom+2][Y], x[atom+2][Z],
-                          x[atom+3][X], x[atom+3][Y], x[atom+3][Z]));
+    return GetXYZ4(atom, atom+1, atom+2, atom+3);
 }
+
 coordinates8 Frame::GetXYZ8(int atom) const
 {
-    return (coordinates8 (x[atom][X], x[atom][Y], x[atom][Z],
-                          x[atom+1][X], x[atom+1][Y], x[atom+1][Z],
-                          x[atom+2][X], x[atom+2][Y], x[atom+2][Z],
-                          x[atom+3][X], x[atom+3][Y], x[atom+3][Z],
-                          x[atom+4][X], x[atom+4][Y], x[atom+4][Z],
-                          x[atom+5][X], x[atom+5][Y], x[atom+5][Z],
-                          x[atom+6][X], x[atom+6][Y], x[atom+6][Z],
-                          x[atom+7][X], x[atom+7][Y], x[atom+7][Z]));
+    return GetXYZ8(atom, atom+1, atom+2, atom+3, atom+4, atom+5, atom+6, atom+7);
 }
 
 coordinates4 Frame::GetXYZ4(int a, int b, int c, int d) const
 {
-    return (coordinates4 (x[a][X], x[a][Y], x[a][Z],
-                          x[b][X], x[b][Y], x[b][Z],
-                          x[c][X], x[c][Y], x[c][Z],
-                          x[d][X], x[d][Y], x[d][Z]));
+    rvec tmp[4];
+    const float *pa = xyz(a, tmp[0]);
+    const float *pb = xyz(b, tmp[1]);
+    const float *pc = xyz(c, tmp[2]);
+    const float *pd = xyz(d, tmp[3]);
+    return (coordinates4 (pa[X], pa[Y], pa[Z],
+                          pb[X], pb[Y], pb[Z],
+                          pc[X], pc[Y], pc[Z],
+                          pd[X], pd[Y], pd[Z]));
 }
 
 coordinates8 Frame::GetXYZ8(int a, int b, int c, int d,
                             int e, int f, int g, int h) const
 {
-    return (coordinates8 (x[a][X], x[a][Y], x[a][Z],
-                          x[b][X], x[b][Y], x[b][Z],
-                          x[c][X], x[c][Y], x[c][Z],
-                          x[d][X], x[d][Y], x[d][Z],
-                          x[e][X], x[e][Y], x[e][Z],
-                          x[f][X], x[f][Y], x[f][Z],
-                          x[g][X], x[g][Y], x[g][Z],
-                          x[h][X], x[h][Y], x[h][Z]));
+    rvec tmp[8];
+    const float *pa = xyz(a, tmp[0]);
+    const float *pb = xyz(b, tmp[1]);
+    const float *pc = xyz(c, tmp[2]);
+    const float *pd = xyz(d, tmp[3]);
+    const float *pe = xyz(e, tmp[4]);
+    const float *pf = xyz(f, tmp[5]);
+    const float *pg = xyz(g, tmp[6]);
+    const float *ph = xyz(h, tmp[7]);
+    return (coordinates8 (pa[X], pa[Y], pa[Z],
+                          pb[X], pb[Y], pb[Z],
+                          pc[X], pc[Y], pc[Z],
+                          pd[X], pd[Y], pd[Z],
+                          pe[X], pe[Y], pe[Z],
+                          pf[X], pf[Y], pf[Z],
+                          pg[X], pg[Y], pg[Z],
+                          ph[X], ph[Y], ph[Z]));
 }
 
 cubicbox_m256 Frame::GetCubicBoxM256() const
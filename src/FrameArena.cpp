@@ -0,0 +1,129 @@
+/*
+ * libgmxcpp
+ * Copyright (C) 2015 James W. Barnett <jbarnet4@tulane.edu>
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The full license is located in a text file titled "LICENSE" in the root
+ * directory of the source.
+ *
+ */
+
+/**
+ * @file
+ * @brief FrameArena class
+ * @see FrameArena.h
+ */
+
+#include "gmxcpp/FrameArena.h"
+#include <new>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+FrameArena::FrameArena()
+{
+    natoms = 0;
+    frames = 0;
+    used = 0;
+    size = 0;
+    hugePages = false;
+}
+
+FrameArena::FrameArena(const FrameArena &other)
+{
+    natoms = other.natoms;
+    frames = other.frames;
+    used = 0;
+    size = 0;
+    hugePages = other.hugePages;
+}
+
+FrameArena& FrameArena::operator=(const FrameArena &other)
+{
+    if (this == &other)
+    {
+        return *this;
+    }
+    natoms = other.natoms;
+    frames = other.frames;
+    used = 0;
+    size = 0;
+    hugePages = other.hugePages;
+    block.reset();
+    return *this;
+}
+
+void FrameArena::Reset(int natoms, size_t nframes)
+{
+    this->natoms = natoms;
+    this->frames = (nframes > 0) ? nframes : 1;
+    used = 0;
+    if (block && (block.use_count() > 1 || size < frames * natoms * DIM))
+    {
+        block.reset();
+    }
+    if (block)
+    {
+        /* Reusing the block, so it holds as many frames as fit. */
+        frames = (natoms > 0) ? size / (natoms * DIM) : frames;
+    }
+    return;
+}
+
+void FrameArena::SetHugePages(bool on)
+{
+    hugePages = on;
+    return;
+}
+
+shared_ptr <float> FrameArena::Next()
+{
+    if (!block || used == frames)
+    {
+        size = frames * natoms * DIM;
+        block = allocate(size);
+        used = 0;
+    }
+    float *x = block.get() + used * natoms * DIM;
+    ++used;
+    return shared_ptr <float> (block, x);
+}
+
+/*
+ * On Linux the block is mapped anonymously, so pages are only backed by memory
+ * once they are written, and can be advised to use transparent huge pages.
+ * Nothing is reserved for pages not yet written, so a block sized for frames
+ * that turn out not to be in the file costs nothing.
+ */
+shared_ptr <float> FrameArena::allocate(size_t n) const
+{
+    const size_t bytes = (n > 0 ? n : 1) * sizeof(float);
+#ifdef __linux__
+    void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED)
+    {
+        throw bad_alloc();
+    }
+#ifdef MADV_HUGEPAGE
+    if (hugePages)
+    {
+        madvise(p, bytes, MADV_HUGEPAGE);
+    }
+#endif
+    return shared_ptr <float> ((float*) p, [bytes](float *p) { munmap(p, bytes); });
+#else
+    return shared_ptr <float> (new float[n], default_delete<float[]>());
+#endif
+}
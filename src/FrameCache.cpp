@@ -0,0 +1,344 @@
+/*
+ * libgmxcpp
+ * Copyright (C) 2015 James W. Barnett <jbarnet4@tulane.edu>
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The full license is located in a text file titled "LICENSE" in the root
+ * directory of the source.
+ *
+ */
+
+/**
+ * @file
+ * @brief FrameCache class
+ * @see FrameCache.h
+ */
+
+#include "gmxcpp/FrameCache.h"
+#include "gmxcpp/FrameIndex.h"
+#include "xdrfile_xtc.h"
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Identifies a cache file and its layout. */
+static const char CACHE_MAGIC[8] = { 'G', 'M', 'X', 'C', 'A', 'C', 'H', 'E' };
+static const int32_t CACHE_VERSION = 1;
+
+/* Frames start on this boundary in the file, and so in memory. */
+static const int64_t CACHE_ALIGN = 64;
+
+struct CacheHeader {
+    char magic[8];
+    int32_t version;
+    int32_t natoms;
+    int64_t nframes;
+    int64_t table;
+    char unused[CACHE_ALIGN - 32];
+};
+
+struct CacheEntry {
+    int64_t offset;
+    int32_t step;
+    float time;
+    float box[DIM][DIM];
+    int32_t unused;
+};
+
+static int64_t align(int64_t n)
+{
+    return (n + CACHE_ALIGN - 1) / CACHE_ALIGN * CACHE_ALIGN;
+}
+
+/* The floats are saved as they are in memory, which is only the layout of the
+ * file on little-endian machines. */
+static void checkByteOrder()
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    throw runtime_error("Cache files are only supported on little-endian machines.");
+#endif
+}
+
+/* Shared memory objects are named as "shm:/name". */
+static bool isShared(const string &name)
+{
+    return name.compare(0, 4, "shm:") == 0;
+}
+
+FrameCache::FrameCache(string cachefile)
+{
+    checkByteOrder();
+    this->cachefile = cachefile;
+
+    int fd = isShared(cachefile) ? shm_open(cachefile.substr(4).c_str(), O_RDONLY, 0) : open(cachefile.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw runtime_error("Cannot open " + cachefile + ".");
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(CacheHeader))
+    {
+        ::close(fd);
+        throw runtime_error(cachefile + " is not a cache file.");
+    }
+    const size_t size = st.st_size;
+
+    /* Private and writable, so that frames in it can be changed (e.g. by
+     * Frame::CenterAtoms) without changing the file. */
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+    {
+        throw runtime_error("Cannot map " + cachefile + ".");
+    }
+    data = shared_ptr <unsigned char> ((unsigned char*) p, [size](unsigned char *p) { munmap(p, size); });
+
+    const CacheHeader *header = (const CacheHeader*) data.get();
+    if (memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header->version != CACHE_VERSION)
+    {
+        throw runtime_error(cachefile + " is not a cache file, or is still being written.");
+    }
+    natoms = header->natoms;
+    nframes = header->nframes;
+
+    if (natoms <= 0 || nframes < 0 ||
+        header->table + (int64_t) nframes * (int64_t) sizeof(CacheEntry) > (int64_t) size)
+    {
+        throw runtime_error(cachefile + " is truncated.");
+    }
+
+    /* Frames are written in order, so if the last one is complete they all are. */
+    const int64_t frameBytes = align((int64_t) natoms * sizeof(rvec));
+    if (nframes > 0 && ((const CacheEntry*) entry(nframes - 1))->offset + frameBytes > (int64_t) size)
+    {
+        throw runtime_error(cachefile + " is truncated.");
+    }
+}
+
+/*
+ * The header and table are written last, once the step, time and box of every
+ * frame are known. The frame index tells us how many frames there are, so the
+ * space for the table can be left before the frames.
+ */
+int FrameCache::Write(string xtcfile, string cachefile)
+{
+    checkByteOrder();
+    if (cachefile.empty())
+    {
+        cachefile = xtcfile + ".cache";
+    }
+
+    FrameIndex frameIndex(xtcfile);
+    const int natoms = frameIndex.GetNAtoms();
+    const int nframes = frameIndex.GetNFrames();
+    const int64_t frameBytes = align((int64_t) natoms * sizeof(rvec));
+    const int64_t start = align(sizeof(CacheHeader) + (int64_t) nframes * sizeof(CacheEntry));
+
+    XDRFILE *xd = xdrfile_open(xtcfile.c_str(), "r");
+    if (xd == NULL)
+    {
+        throw runtime_error("Cannot open " + xtcfile + ".");
+    }
+    FILE *fp = fopen(cachefile.c_str(), "wb");
+    if (fp == NULL)
+    {
+        xdrfile_close(xd);
+        throw runtime_error("Cannot write " + cachefile + ".");
+    }
+
+    vector <CacheEntry> table(nframes);
+    vector <char> frame(frameBytes, 0);
+    bool ok = (fseeko(fp, start, SEEK_SET) == 0);
+    for (int i = 0; ok && i < nframes; i++)
+    {
+        float prec;
+        CacheEntry &e = table[i];
+        memset(&e, 0, sizeof(e));
+        e.offset = start + i * frameBytes;
+        ok = (read_xtc(xd, natoms, &e.step, &e.time, e.box, (rvec*) frame.data(), &prec) == exdrOK) &&
+             (fwrite(frame.data(), 1, frameBytes, fp) == (size_t) frameBytes);
+    }
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.natoms = natoms;
+    header.nframes = nframes;
+    header.table = sizeof(CacheHeader);
+    ok = ok && (fseeko(fp, 0, SEEK_SET) == 0) &&
+         (fwrite(&header, sizeof(header), 1, fp) == 1) &&
+         (fwrite(table.data(), sizeof(CacheEntry), nframes, fp) == (size_t) nframes);
+    ok = (fclose(fp) == 0) && ok;
+    xdrfile_close(xd);
+
+    if (!ok)
+    {
+        remove(cachefile.c_str());
+        throw runtime_error("Cannot write " + cachefile + ".");
+    }
+    return nframes;
+}
+
+/*
+ * The frames are decoded straight into the shared memory, each thread taking
+ * a contiguous block of frames and reading them with its own handle on the
+ * xtc file. The header is written last, so a process attaching before all
+ * frames are in place finds no cache there.
+ */
+int FrameCache::Publish(string xtcfile, string name, int nthreads)
+{
+    checkByteOrder();
+    if (nthreads < 1)
+    {
+        throw runtime_error("Number of threads must be at least 1.");
+    }
+
+    FrameIndex frameIndex(xtcfile);
+    const int natoms = frameIndex.GetNAtoms();
+    const int nframes = frameIndex.GetNFrames();
+    const int64_t frameBytes = align((int64_t) natoms * sizeof(rvec));
+    const int64_t start = align(sizeof(CacheHeader) + (int64_t) nframes * sizeof(CacheEntry));
+    const size_t size = start + nframes * frameBytes;
+
+    /* An object with the same name is unlinked rather than truncated, so
+     * processes that have it open keep the frames they have. */
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0)
+    {
+        throw runtime_error("Cannot create shared memory " + name + ".");
+    }
+    void *p = (ftruncate(fd, size) == 0) ? mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (p == MAP_FAILED)
+    {
+        shm_unlink(name.c_str());
+        throw runtime_error("Cannot create shared memory " + name + ".");
+    }
+    unsigned char *base = (unsigned char*) p;
+    CacheEntry *table = (CacheEntry*) (base + sizeof(CacheHeader));
+
+    vector <int> status(nframes, -1);
+    #pragma omp parallel num_threads(nthreads)
+    {
+        XDRFILE *xd = xdrfile_open(xtcfile.c_str(), "rm");
+        int64_t next = -1;
+        float prec;
+
+        #pragma omp for schedule(static)
+        for (int i = 0; i < nframes; i++)
+        {
+            CacheEntry &e = table[i];
+            memset(&e, 0, sizeof(e));
+            e.offset = start + i * frameBytes;
+            if (xd == NULL ||
+                (next != frameIndex.GetOffset(i) && xdrfile_seek(xd, frameIndex.GetOffset(i), SEEK_SET) != 0) ||
+                read_xtc(xd, natoms, &e.step, &e.time, e.box, (rvec*) (base + e.offset), &prec) != exdrOK)
+            {
+                next = -1;
+                continue;
+            }
+            next = xdrfile_tell(xd);
+            status[i] = 0;
+        }
+
+        if (xd != NULL)
+        {
+            xdrfile_close(xd);
+        }
+    }
+
+    bool ok = true;
+    for (int i = 0; i < nframes; i++)
+    {
+        ok = ok && (status[i] == 0);
+    }
+    if (ok)
+    {
+        CacheHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        header.version = CACHE_VERSION;
+        header.natoms = natoms;
+        header.nframes = nframes;
+        header.table = sizeof(CacheHeader);
+        memcpy(base, &header, sizeof(header));
+    }
+    munmap(p, size);
+
+    if (!ok)
+    {
+        shm_unlink(name.c_str());
+        throw runtime_error("Cannot decode " + xtcfile + " into shared memory " + name + ".");
+    }
+    return nframes;
+}
+
+void FrameCache::Unpublish(string name)
+{
+    if (shm_unlink(name.c_str()) != 0)
+    {
+        throw runtime_error("Cannot remove shared memory " + name + ".");
+    }
+    return;
+}
+
+const void* FrameCache::entry(int frame) const
+{
+    if (frame < 0 || frame >= nframes)
+    {
+        throw runtime_error("Frame " + to_string(frame) + " is not in " + cachefile + ".");
+    }
+    const CacheHeader *header = (const CacheHeader*) data.get();
+    return data.get() + header->table + (int64_t) frame * sizeof(CacheEntry);
+}
+
+int FrameCache::GetNFrames() const
+{
+    return nframes;
+}
+
+int FrameCache::GetNAtoms() const
+{
+    return natoms;
+}
+
+int FrameCache::GetStep(int frame) const
+{
+    return ((const CacheEntry*) entry(frame))->step;
+}
+
+float FrameCache::GetTime(int frame) const
+{
+    return ((const CacheEntry*) entry(frame))->time;
+}
+
+void FrameCache::GetBox(int frame, matrix box) const
+{
+    memcpy(box, ((const CacheEntry*) entry(frame))->box, sizeof(matrix));
+    return;
+}
+
+shared_ptr <float> FrameCache::GetXYZ(int frame) const
+{
+    const int64_t offset = ((const CacheEntry*) entry(frame))->offset;
+    return shared_ptr <float> (data, (float*) (data.get() + offset));
+}
@@ -0,0 +1,275 @@
+/*
+ * libgmxcpp
+ * Copyright (C) 2015 James W. Barnett <jbarnet4@tulane.edu>
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The full license is located in a text file titled "LICENSE" in the root
+ * directory of the source.
+ *
+ */
+
+/**
+ * @file
+ * @brief FrameIndex class
+ * @see FrameIndex.h
+ */
+
+#include "gmxcpp/FrameIndex.h"
+#include "xdrfile.h"
+#include "xdrfile_xtc.h"
+#include <stdio.h>
+#include <sys/stat.h>
+
+/* Identifies an index file and its layout. The magic number is also how we
+ * notice an index written on a machine with different byte order. */
+static const int32_t IDX_MAGIC = 0x58445849;
+static const int32_t IDX_VERSION = 1;
+
+FrameIndex::FrameIndex()
+{
+    natoms = 0;
+    fsize = 0;
+    fmtime = 0;
+}
+
+FrameIndex::FrameIndex(string xtcfile)
+{
+    init(xtcfile);
+}
+
+void FrameIndex::init(string xtcfile, bool verbose)
+{
+    this->xtcfile = xtcfile;
+    this->idxfile = xtcfile + ".idx";
+    natoms = 0;
+    fsize = 0;
+    fmtime = 0;
+
+    if (load())
+    {
+        if (verbose)
+        {
+            cout << "Loaded frame index " << idxfile << " (" << GetNFrames() << " frames)." << endl;
+        }
+        return;
+    }
+
+    if (verbose)
+    {
+        cout << "Building frame index for " << xtcfile << "...";
+    }
+    build();
+    if (verbose)
+    {
+        cout << "OK (" << GetNFrames() << " frames)" << endl;
+    }
+
+    if (!save())
+    {
+        cerr << "NOTE: Could not write " << idxfile << ". Frame index kept in memory only." << endl;
+    }
+
+    return;
+}
+
+bool FrameIndex::initSaved(string xtcfile)
+{
+    this->xtcfile = xtcfile;
+    this->idxfile = xtcfile + ".idx";
+    natoms = 0;
+    fsize = 0;
+    fmtime = 0;
+
+    if (!load())
+    {
+        return false;
+    }
+    cout << "Loaded frame index " << idxfile << " (" << GetNFrames() << " frames)." << endl;
+    return true;
+}
+
+bool FrameIndex::stat(int64_t &size, int64_t &mtime) const
+{
+    struct stat st;
+    if (::stat(xtcfile.c_str(), &st) != 0)
+    {
+        return false;
+    }
+    size = st.st_size;
+    mtime = (int64_t) st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+}
+
+bool FrameIndex::load()
+{
+    int64_t size;
+    int64_t mtime;
+    if (!stat(size, mtime))
+    {
+        throw runtime_error("Cannot open " + xtcfile + ".");
+    }
+
+    FILE *fp = fopen(idxfile.c_str(), "rb");
+    if (fp == NULL)
+    {
+        return false;
+    }
+
+    int32_t header[4];
+    int64_t fileinfo[2];
+    bool ok = (fread(header, sizeof(int32_t), 4, fp) == 4) &&
+              (fread(fileinfo, sizeof(int64_t), 2, fp) == 2) &&
+              header[0] == IDX_MAGIC && header[1] == IDX_VERSION &&
+              header[3] >= 0 && fileinfo[0] == size && fileinfo[1] == mtime;
+
+    if (ok)
+    {
+        const int n = header[3];
+        natoms = header[2];
+        fsize = fileinfo[0];
+        fmtime = fileinfo[1];
+        offsets.resize(n);
+        steps.resize(n);
+        times.resize(n);
+        ok = (fread(offsets.data(), sizeof(int64_t), n, fp) == (size_t) n) &&
+             (fread(steps.data(), sizeof(int), n, fp) == (size_t) n) &&
+             (fread(times.data(), sizeof(float), n, fp) == (size_t) n);
+    }
+    fclose(fp);
+
+    if (!ok)
+    {
+        natoms = 0;
+        offsets.clear();
+        steps.clear();
+        times.clear();
+    }
+    return ok;
+}
+
+/*
+ * Reads the header of each frame in the xtc file, recording where each frame
+ * starts, and skips the coordinates without decompressing them. A truncated
+ * last frame (e.g. from a simulation that is still running) is not recorded.
+ */
+void FrameIndex::build()
+{
+    if (!stat(fsize, fmtime))
+    {
+        throw runtime_error("Cannot open " + xtcfile + ".");
+    }
+
+    char *cfilename = const_cast<char*>(xtcfile.c_str());
+    if (read_xtc_natoms(cfilename, &natoms) != exdrOK)
+    {
+        throw runtime_error("Cannot open " + xtcfile + ".");
+    }
+
+    XDRFILE *xd = xdrfile_open(cfilename, "rm");
+    if (xd == NULL)
+    {
+        throw runtime_error("Cannot open " + xtcfile + ".");
+    }
+
+    /* Only the headers are read, so there is nothing to gain from readahead. */
+    xdrfile_advise(xd, xdrRANDOM);
+
+    offsets.clear();
+    steps.clear();
+    times.clear();
+
+    int step;
+    float time;
+    matrix box;
+    int64_t offset = xdrfile_tell(xd);
+
+    while (skip_xtc(xd, natoms, &step, &time, box) == exdrOK)
+    {
+        offsets.push_back(offset);
+        steps.push_back(step);
+        times.push_back(time);
+        offset = xdrfile_tell(xd);
+    }
+
+    xdrfile_close(xd);
+    return;
+}
+
+bool FrameIndex::save() const
+{
+    FILE *fp = fopen(idxfile.c_str(), "wb");
+    if (fp == NULL)
+    {
+        return false;
+    }
+
+    const int n = GetNFrames();
+    int32_t header[4] = { IDX_MAGIC, IDX_VERSION, natoms, n };
+    int64_t fileinfo[2] = { fsize, fmtime };
+    bool ok = (fwrite(header, sizeof(int32_t), 4, fp) == 4) &&
+              (fwrite(fileinfo, sizeof(int64_t), 2, fp) == 2) &&
+              (fwrite(offsets.data(), sizeof(int64_t), n, fp) == (size_t) n) &&
+              (fwrite(steps.data(), sizeof(int), n, fp) == (size_t) n) &&
+              (fwrite(times.data(), sizeof(float), n, fp) == (size_t) n);
+    ok = (fclose(fp) == 0) && ok;
+
+    if (!ok)
+    {
+        remove(idxfile.c_str());
+    }
+    return ok;
+}
+
+bool FrameIndex::IsLoaded() const
+{
+    return natoms > 0;
+}
+
+bool FrameIndex::IsStale() const
+{
+    int64_t size;
+    int64_t mtime;
+    return !stat(size, mtime) || size != fsize || mtime != fmtime;
+}
+
+int FrameIndex::GetNFrames() const
+{
+    return offsets.size();
+}
+
+int FrameIndex::GetNAtoms() const
+{
+    return natoms;
+}
+
+int64_t FrameIndex::GetOffset(int frame) const
+{
+    return offsets.at(frame);
+}
+
+int FrameIndex::GetStep(int frame) const
+{
+    return steps.at(frame);
+}
+
+float FrameIndex::GetTime(int frame) const
+{
+    return times.at(frame);
+}
+
+string FrameIndex::GetFilename() const
+{
+    return idxfile;
+}
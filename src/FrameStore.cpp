@@ -0,0 +1,300 @@
+/*
+ * libgmxcpp
+ * Copyright (C) 2015 James W. Barnett <jbarnet4@tulane.edu>
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The full license is located in a text file titled "LICENSE" in the root
+ * directory of the source.
+ *
+ */
+
+/**
+ * @file
+ * @brief FrameStore class
+ * @see FrameStore.h
+ */
+
+#include "gmxcpp/FrameStore.h"
+#include "gmxcpp/coordinates.h"
+#include "xdrfile_xtc.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+FrameStore::FrameStore(int natoms, const vector <int> &atoms, size_t capacity)
+{
+    this->natoms = natoms;
+    this->atoms = atoms;
+    this->capacity = (capacity > 0) ? capacity : 1;
+    mapsize = 0;
+    readahead = 0;
+    lastFrame = -2;
+    stopping = false;
+}
+
+FrameStore::FrameStore(string xtcfile, int natoms, const vector <int> &atoms, size_t capacity, int readahead)
+    : FrameStore(natoms, atoms, capacity)
+{
+    this->xtcfile = xtcfile;
+
+    /* Decoding ahead must not push out the frame just gotten. */
+    this->readahead = min(readahead, (int) (this->capacity / 2));
+
+    int fd = open(xtcfile.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw runtime_error("Cannot open " + xtcfile + ".");
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        throw runtime_error("Cannot open " + xtcfile + ".");
+    }
+    const size_t size = st.st_size;
+    void *p = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+    {
+        throw runtime_error("Cannot map " + xtcfile + ".");
+    }
+    mapped = shared_ptr <unsigned char> ((unsigned char*) p, [size](unsigned char *p) { munmap(p, size); });
+    mapsize = size;
+}
+
+FrameStore::~FrameStore()
+{
+    {
+        lock_guard <mutex> guard(lock);
+        stopping = true;
+        changed.notify_all();
+    }
+    if (worker.joinable())
+    {
+        worker.join();
+    }
+}
+
+/*
+ * The frame is skipped over once to find where it ends, then read again as
+ * raw bytes. With a memory-mapped file both are just a walk over the page
+ * cache. When frames are left in the file, only where the frame is is kept.
+ */
+int FrameStore::Add(XDRFILE *xd, int *step, float *time, matrix box)
+{
+    const int64_t start = xdrfile_tell(xd);
+    if (start < 0 || skip_xtc(xd, natoms, step, time, box) != exdrOK)
+    {
+        return -1;
+    }
+    const int64_t size = xdrfile_tell(xd) - start;
+
+    if (mapped)
+    {
+        if (start + size > mapsize)
+        {
+            return -1;
+        }
+        offsets.push_back(start);
+        sizes.push_back(size);
+        return 0;
+    }
+
+    const size_t at = data.size();
+    data.resize(at + size);
+    if (xdrfile_seek(xd, start, SEEK_SET) != 0 ||
+        xdrfile_read_opaque((char*) data.data() + at, size, xd) != size)
+    {
+        data.resize(at);
+        return -1;
+    }
+    offsets.push_back(at);
+    sizes.push_back(size);
+    return 0;
+}
+
+shared_ptr <float> FrameStore::decode(int frame) const
+{
+    const unsigned char *start = (mapped ? mapped.get() : data.data()) + offsets[frame];
+    XDRFILE *xd = xdrfile_open_memory(start, sizes[frame]);
+    if (xd == NULL)
+    {
+        throw runtime_error("Cannot decode frame " + to_string(frame) + (mapped ? " of " + xtcfile : " kept in memory") + ".");
+    }
+
+    const int nsaved = atoms.empty() ? natoms : atoms.size();
+    shared_ptr <float> x(new float[nsaved * DIM], default_delete<float[]>());
+    vector <float> all(atoms.empty() ? 0 : natoms * DIM);
+    rvec *dest = (rvec*) (atoms.empty() ? x.get() : all.data());
+
+    int step;
+    float time;
+    float prec;
+    matrix box;
+    const int status = read_xtc(xd, natoms, &step, &time, box, dest, &prec);
+    xdrfile_close(xd);
+    if (status != exdrOK)
+    {
+        throw runtime_error("Cannot decode frame " + to_string(frame) + (mapped ? " of " + xtcfile : " kept in memory") + ".");
+    }
+
+    rvec *saved = (rvec*) x.get();
+    for (size_t i = 0; i < atoms.size(); i++)
+    {
+        saved[i][X] = dest[atoms[i]][X];
+        saved[i][Y] = dest[atoms[i]][Y];
+        saved[i][Z] = dest[atoms[i]][Z];
+    }
+    return x;
+}
+
+/*
+ * Decoding is done without holding the lock, so threads asking for different
+ * frames decode them at the same time. Two threads asking for the same frame
+ * that is not decoded may both decode it; only one copy is kept.
+ *
+ * When a frame is asked for right after the one before it, the next frames
+ * are queued to be decoded ahead. A frame asked for while it is being decoded
+ * ahead is waited for; one still in the queue is taken out and decoded here.
+ * Any other frame means the frames are no longer gotten in order, so the
+ * queue is dropped.
+ */
+shared_ptr <float> FrameStore::Get(int frame) const
+{
+    if (frame < 0 || frame >= GetNFrames())
+    {
+        throw runtime_error("Frame " + to_string(frame) + " was not read in.");
+    }
+
+    {
+        unique_lock <mutex> guard(lock);
+        if (readahead > 0)
+        {
+            auto pos = find(ahead.begin(), ahead.end(), frame);
+            if (pos != ahead.end())
+            {
+                ahead.erase(pos);
+                queued.erase(frame);
+            }
+            else if (queued.count(frame) != 0)
+            {
+                changed.wait(guard, [this, frame] { return queued.count(frame) == 0; });
+            }
+
+            if (frame == lastFrame + 1)
+            {
+                for (int next = frame + 1; next <= frame + readahead && next < GetNFrames(); next++)
+                {
+                    if (decoded.count(next) == 0 && queued.insert(next).second)
+                    {
+                        ahead.push_back(next);
+                    }
+                }
+                if (!worker.joinable())
+                {
+                    worker = thread(&FrameStore::decodeAhead, this);
+                }
+                changed.notify_all();
+            }
+            else
+            {
+                for (size_t i = 0; i < ahead.size(); i++)
+                {
+                    queued.erase(ahead[i]);
+                }
+                ahead.clear();
+            }
+            lastFrame = frame;
+        }
+
+        auto it = decoded.find(frame);
+        if (it != decoded.end())
+        {
+            recent.splice(recent.begin(), recent, it->second);
+            return it->second->second;
+        }
+    }
+
+    shared_ptr <float> x = decode(frame);
+
+    lock_guard <mutex> guard(lock);
+    keep(frame, x);
+    return x;
+}
+
+void FrameStore::keep(int frame, shared_ptr <float> x) const
+{
+    if (decoded.count(frame) == 0)
+    {
+        recent.push_front(make_pair(frame, x));
+        decoded[frame] = recent.begin();
+        if (recent.size() > capacity)
+        {
+            decoded.erase(recent.back().first);
+            recent.pop_back();
+        }
+    }
+    return;
+}
+
+void FrameStore::decodeAhead() const
+{
+    unique_lock <mutex> guard(lock);
+    while (true)
+    {
+        changed.wait(guard, [this] { return stopping || !ahead.empty(); });
+        if (stopping)
+        {
+            return;
+        }
+        const int frame = ahead.front();
+        ahead.pop_front();
+
+        guard.unlock();
+        shared_ptr <float> x;
+        try
+        {
+            x = decode(frame);
+        }
+        catch (exception &excpt)
+        {
+            /* Left to be decoded, and the error reported, when it is asked
+             * for. This includes running out of memory, which is likely when
+             * frames are stored compressed. */
+        }
+        guard.lock();
+
+        if (x)
+        {
+            keep(frame, x);
+        }
+        queued.erase(frame);
+        changed.notify_all();
+    }
+}
+
+int FrameStore::GetNFrames() const
+{
+    return offsets.size();
+}
+
+size_t FrameStore::GetSize() const
+{
+    return data.size();
+}
@@ -0,0 +1,187 @@
+/*
+ * libgmxcpp
+ * Copyright (C) 2015 James W. Barnett <jbarnet4@tulane.edu>
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The full license is located in a text file titled "LICENSE" in the root
+ * directory of the source.
+ *
+ */
+
+/**
+ * @file
+ * @brief FrameStream class
+ * @see FrameStream.h
+ */
+
+#include "gmxcpp/FrameStream.h"
+#include <stdexcept>
+
+FrameStream::FrameStream(string xtcfile, int natoms, const FrameIndex *frameIndex,
+                         const FrameArena &arena, int b, int s, int e)
+{
+    if (s < 1)
+    {
+        throw runtime_error("Frames to skip in a stream must be at least 1.");
+    }
+    this->natoms = natoms;
+    this->frameIndex = frameIndex;
+    this->arena = arena;
+    this->s = s;
+    this->e = e;
+    /* Like Trajectory::read, start at the first multiple of s at or after b. */
+    this->next = (b % s == 0) ? b : b + s - b % s;
+    this->position = 0;
+    this->done = false;
+    this->started = false;
+
+    xd = xdrfile_open(xtcfile.c_str(), "rm");
+    if (xd == NULL)
+    {
+        throw runtime_error("Cannot open " + xtcfile + ".");
+    }
+}
+
+FrameStream::FrameStream(FrameStream &&other) noexcept
+{
+    xd = other.xd;
+    natoms = other.natoms;
+    frameIndex = other.frameIndex;
+    s = other.s;
+    e = other.e;
+    next = other.next;
+    position = other.position;
+    done = other.done;
+    started = other.started;
+    arena = other.arena;
+    frame = move(other.frame);
+    other.xd = NULL;
+    other.done = true;
+}
+
+FrameStream::~FrameStream()
+{
+    if (xd != NULL)
+    {
+        xdrfile_close(xd);
+    }
+}
+
+/*
+ * Frames in between are passed over with the frame index if we have one, or
+ * by skipping their coordinates otherwise (e.g. past the end of an index built
+ * before the file grew).
+ */
+void FrameStream::advance()
+{
+    if (done || (e != -1 && next >= e))
+    {
+        done = true;
+        frame = Frame();
+        return;
+    }
+
+    if (position != next)
+    {
+        if (frameIndex != NULL && next < frameIndex->GetNFrames())
+        {
+            if (xdrfile_seek(xd, frameIndex->GetOffset(next), SEEK_SET) != 0)
+            {
+                done = true;
+                frame = Frame();
+                return;
+            }
+            position = next;
+        }
+        int step;
+        float time;
+        matrix box;
+        while (position < next && skip_xtc(xd, natoms, &step, &time, box) == exdrOK)
+        {
+            ++position;
+        }
+    }
+
+    /* Drop our reference first, so the buffer is reused unless the caller
+     * kept a copy of the last frame. */
+    frame = Frame();
+    arena.Reset(natoms, 1);
+    shared_ptr <float> x = arena.Next();
+
+    int step;
+    float time;
+    float prec;
+    matrix box;
+    if (position != next ||
+        read_xtc(xd, natoms, &step, &time, box, (rvec*) x.get(), &prec) != exdrOK)
+    {
+        done = true;
+        return;
+    }
+    frame = Frame(step, time, box, x, natoms);
+    ++position;
+    next += s;
+    return;
+}
+
+FrameStream::iterator FrameStream::begin()
+{
+    if (!started)
+    {
+        started = true;
+        advance();
+    }
+    return done ? iterator() : iterator(this);
+}
+
+FrameStream::iterator FrameStream::end()
+{
+    return iterator();
+}
+
+FrameStream::iterator::iterator(FrameStream *stream)
+{
+    this->stream = stream;
+}
+
+const Frame& FrameStream::iterator::operator*() const
+{
+    return stream->frame;
+}
+
+const Frame* FrameStream::iterator::operator->() const
+{
+    return &stream->frame;
+}
+
+FrameStream::iterator& FrameStream::iterator::operator++()
+{
+    stream->advance();
+    if (stream->done)
+    {
+        stream = NULL;
+    }
+    return *this;
+}
+
+bool FrameStream::iterator::operator==(const iterator &other) const
+{
+    return stream == other.stream;
+}
+
+bool FrameStream::iterator::operator!=(const iterator &other) const
+{
+    return stream != other.stream;
+}
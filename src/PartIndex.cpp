@@ -0,0 +1,161 @@
+/*
+ * libgmxcpp
+ * Copyright (C) 2015 James W. Barnett <jbarnet4@tulane.edu>
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The full license is located in a text file titled "LICENSE" in the root
+ * directory of the source.
+ *
+ */
+
+
+/**
+ * @file
+ * @brief PartIndex class
+ * @see PartIndex.h
+ */
+
+#include "gmxcpp/PartIndex.h"
+#include <algorithm>
+#include <glob.h>
+#include <iostream>
+
+/*
+ * Building a frame index only reads the frame headers, so it is limited by
+ * reading the files rather than by the CPU, and several files can be read at
+ * the same time. Each thread takes the next file not yet indexed.
+ */
+PartIndex::PartIndex(const vector <string> &xtcfiles)
+{
+    if (xtcfiles.empty())
+    {
+        throw runtime_error("No trajectory files given.");
+    }
+    files = xtcfiles;
+    indexes.resize(files.size());
+
+    cout << "Indexing " << files.size() << " files...";
+    string error;
+    #pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < (int) files.size(); i++)
+    {
+        try
+        {
+            indexes[i].init(files[i], false);
+        }
+        catch (runtime_error &excpt)
+        {
+            #pragma omp critical
+            error = excpt.what();
+        }
+    }
+    if (!error.empty())
+    {
+        throw runtime_error(error);
+    }
+
+    first.push_back(0);
+    int lastStep = 0;
+    bool any = false;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        if (indexes[i].GetNAtoms() != indexes[0].GetNAtoms())
+        {
+            throw runtime_error(files[i] + " does not have the same number of atoms as " + files[0] + ".");
+        }
+        const int n = indexes[i].GetNFrames();
+        int skip = 0;
+        if (any && n > 0 && indexes[i].GetStep(0) == lastStep)
+        {
+            skip = 1;
+        }
+        skipped.push_back(skip);
+        first.push_back(first.back() + n - skip);
+        if (n > 0)
+        {
+            lastStep = indexes[i].GetStep(n - 1);
+            any = true;
+        }
+    }
+    cout << "OK (" << GetNFrames() << " frames)" << endl;
+}
+
+vector <string> PartIndex::Glob(string pattern)
+{
+    vector <string> names;
+    glob_t g;
+    if (glob(pattern.c_str(), 0, NULL, &g) == 0)
+    {
+        for (size_t i = 0; i < g.gl_pathc; i++)
+        {
+            names.push_back(g.gl_pathv[i]);
+        }
+    }
+    globfree(&g);
+    sort(names.begin(), names.end());
+    return names;
+}
+
+int PartIndex::GetNParts() const
+{
+    return files.size();
+}
+
+string PartIndex::GetFilename(int part) const
+{
+    return files.at(part);
+}
+
+int PartIndex::GetNFrames() const
+{
+    return first.back();
+}
+
+int PartIndex::GetNAtoms() const
+{
+    return indexes[0].GetNAtoms();
+}
+
+/* The last file starting at or before the frame. Files with no frames start
+ * at the same frame as the next one, so they are passed over. */
+int PartIndex::GetPart(int frame) const
+{
+    if (frame < 0 || frame >= GetNFrames())
+    {
+        throw runtime_error("Frame " + to_string(frame) + " is not in the trajectory.");
+    }
+    return upper_bound(first.begin(), first.end(), frame) - first.begin() - 1;
+}
+
+int PartIndex::GetLocalFrame(int frame) const
+{
+    const int part = GetPart(frame);
+    return frame - first[part] + skipped[part];
+}
+
+int64_t PartIndex::GetOffset(int frame) const
+{
+    return indexes[GetPart(frame)].GetOffset(GetLocalFrame(frame));
+}
+
+int PartIndex::GetStep(int frame) const
+{
+    return indexes[GetPart(frame)].GetStep(GetLocalFrame(frame));
+}
+
+float PartIndex::GetTime(int frame) const
+{
+    return indexes[GetPart(frame)].GetTime(GetLocalFrame(frame));
+}
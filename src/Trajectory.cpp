@@ -29,10 +29,240 @@
  */
 
 #include "gmxcpp/Trajectory.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <thread>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+/* Frames decoded ahead of the one asked for when going through frames in
+ * order with a memory budget. */
+static const int READAHEAD_FRAMES = 4;
+
+/*
+ * Frames with all atoms are decoded straight into their storage. When only some
+ * atoms are saved the frame is decoded into scratch and those atoms are copied
+ * into its storage afterwards.
+ */
+static void gather(const rvec *x, const vector <int> &atoms, rvec *dest)
+{
+    for (size_t i = 0; i < atoms.size(); ++i)
+    {
+        dest[i][X] = x[atoms[i]][X];
+        dest[i][Y] = x[atoms[i]][Y];
+        dest[i][Z] = x[atoms[i]][Z];
+    }
+    return;
+}
+
+/*
+ * Reads and decodes frames in a background thread into a queue holding at
+ * most depth frames. The thread owns the file position until it is stopped.
+ */
+struct Prefetcher {
+
+    XDRFILE *xd;
+    int natoms;
+    size_t depth;
+
+    /* Atoms saved in each frame, or empty for all of them. */
+    vector <int> atoms;
+
+    /* Frame number of the file position of the background thread. */
+    int position;
+
+    /* Set when the end of the file (or a bad frame) was reached. */
+    bool done;
+    bool stopping;
+
+    /* Storage for the frames decoded ahead. */
+    FrameArena arena;
+
+    deque <Frame> queue;
+    mutex lock;
+    condition_variable changed;
+    thread worker;
+
+    Prefetcher(XDRFILE *xd, int natoms, const vector <int> &atoms, const FrameArena &arena, int depth, int position)
+    {
+        this->arena = arena;
+        this->xd = xd;
+        this->natoms = natoms;
+        this->atoms = atoms;
+        this->depth = depth;
+        this->position = position;
+        this->done = false;
+        this->stopping = false;
+        this->arena.Reset(atoms.empty() ? natoms : atoms.size(), depth);
+        worker = thread(&Prefetcher::run, this);
+    }
+
+    ~Prefetcher()
+    {
+        stop();
+    }
+
+    void run()
+    {
+        vector <float> scratch(atoms.empty() ? 0 : natoms * DIM);
+        float time;
+        float prec;
+        int step;
+        matrix box;
+
+        while (true)
+        {
+            {
+                unique_lock <mutex> guard(lock);
+                changed.wait(guard, [this] { return stopping || queue.size() < depth; });
+                if (stopping)
+                {
+                    return;
+                }
+            }
+
+            /* Decoding is done without holding the lock. */
+            shared_ptr <float> dest = arena.Next();
+            rvec *x = (rvec*) (atoms.empty() ? dest.get() : scratch.data());
+            bool ok = (read_xtc(xd, natoms, &step, &time, box, x, &prec) == exdrOK);
+            Frame frame;
+            if (ok)
+            {
+                gather(x, atoms, (rvec*) dest.get());
+                frame = Frame(step, time, box, dest, atoms.empty() ? natoms : atoms.size());
+            }
+
+            lock_guard <mutex> guard(lock);
+            if (ok)
+            {
+                queue.push_back(move(frame));
+                ++position;
+            }
+            else
+            {
+                done = true;
+            }
+            changed.notify_all();
+            if (done)
+            {
+                return;
+            }
+        }
+    }
+
+    /* Waits for the next frame. Returns false at the end of the file. */
+    bool pop(Frame &frame)
+    {
+        unique_lock <mutex> guard(lock);
+        changed.wait(guard, [this] { return done || !queue.empty(); });
+        if (queue.empty())
+        {
+            return false;
+        }
+        frame = move(queue.front());
+        queue.pop_front();
+        changed.notify_all();
+        return true;
+    }
+
+    /* Drops up to n frames that are already decoded. Returns how many. */
+    int drop(int n)
+    {
+        lock_guard <mutex> guard(lock);
+        int dropped = 0;
+        while (dropped < n && !queue.empty())
+        {
+            queue.pop_front();
+            ++dropped;
+        }
+        changed.notify_all();
+        return dropped;
+    }
+
+    /* Stops the thread. Returns the frame number of the file position. */
+    int stop()
+    {
+        {
+            lock_guard <mutex> guard(lock);
+            stopping = true;
+            changed.notify_all();
+        }
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+        return position;
+    }
+};
+
+/*
+ * Waits for a file to be written to. On Linux inotify wakes us up as soon as
+ * it is; elsewhere, or if inotify is not available, the file is simply looked
+ * at again after a short sleep.
+ */
+struct FileWatch {
+    int fd;
+
+    FileWatch(string filename)
+    {
+        fd = -1;
+#ifdef __linux__
+        fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd >= 0 && inotify_add_watch(fd, filename.c_str(), IN_MODIFY | IN_CLOSE_WRITE) < 0)
+        {
+            ::close(fd);
+            fd = -1;
+        }
+#endif
+    }
+
+    ~FileWatch()
+    {
+#ifdef __linux__
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+#endif
+    }
+
+    /* Returns after the file is written to, or after at most ms milliseconds. */
+    void wait(int ms)
+    {
+#ifdef __linux__
+        if (fd >= 0)
+        {
+            struct pollfd p = { fd, POLLIN, 0 };
+            if (poll(&p, 1, ms) > 0)
+            {
+                char events[4096];
+                while (read(fd, events, sizeof(events)) > 0)
+                {
+                }
+            }
+            return;
+        }
+#endif
+        this_thread::sleep_for(chrono::milliseconds(min(ms, 10)));
+        return;
+    }
+};
 
 Trajectory::Trajectory()
 {
     PrintBanner();
+    this->nthreads = 1;
+    this->prefetchDepth = 0;
+    this->storeFrames = 0;
+    this->memoryBudget = 0;
+    this->quantized = false;
+    this->throwOnError = false;
 }
 
 Trajectory::~Trajectory()
@@ -40,220 +270,1083 @@ Trajectory::~Trajectory()
     vector<Frame>().swap(this->frameArray);
 }
 
-Trajectory::Trajectory(string filename)
+Trajectory::Trajectory(string filename)
+{
+    PrintBanner();
+    this->nthreads = 1;
+    this->prefetchDepth = 0;
+    this->storeFrames = 0;
+    this->memoryBudget = 0;
+    this->quantized = false;
+    this->throwOnError = false;
+    this->filename = filename;
+    open(filename);
+}
+
+Trajectory::Trajectory(string filename, string ndxfile)
+{
+    PrintBanner();
+    this->nthreads = 1;
+    this->prefetchDepth = 0;
+    this->storeFrames = 0;
+    this->memoryBudget = 0;
+    this->quantized = false;
+    this->throwOnError = false;
+    Index index(ndxfile);
+    this->index=index;
+    this->filename = filename;
+    open(filename);
+}
+
+Trajectory::Trajectory(string filename, Index index)
+{
+    PrintBanner();
+    this->nthreads = 1;
+    this->prefetchDepth = 0;
+    this->storeFrames = 0;
+    this->memoryBudget = 0;
+    this->quantized = false;
+    this->throwOnError = false;
+    this->index=index;
+    this->filename = filename;
+    open(filename);
+}
+
+Trajectory::Trajectory(const vector <string> &xtcfiles)
+{
+    PrintBanner();
+    this->nthreads = 1;
+    this->prefetchDepth = 0;
+    this->storeFrames = 0;
+    this->memoryBudget = 0;
+    this->quantized = false;
+    this->throwOnError = false;
+    this->parts = make_shared<PartIndex>(xtcfiles);
+    this->filename = xtcfiles[0];
+    open(filename);
+}
+
+Trajectory::Trajectory(const vector <string> &xtcfiles, string ndxfile)
+{
+    PrintBanner();
+    this->nthreads = 1;
+    this->prefetchDepth = 0;
+    this->storeFrames = 0;
+    this->memoryBudget = 0;
+    this->quantized = false;
+    this->throwOnError = false;
+    Index index(ndxfile);
+    this->index=index;
+    this->parts = make_shared<PartIndex>(xtcfiles);
+    this->filename = xtcfiles[0];
+    open(filename);
+}
+
+Trajectory::Trajectory(const vector <string> &xtcfiles, Index index)
+{
+    PrintBanner();
+    this->nthreads = 1;
+    this->prefetchDepth = 0;
+    this->storeFrames = 0;
+    this->memoryBudget = 0;
+    this->quantized = false;
+    this->throwOnError = false;
+    this->index=index;
+    this->parts = make_shared<PartIndex>(xtcfiles);
+    this->filename = xtcfiles[0];
+    open(filename);
+}
+
+/*
+ * Reads the requested frames from the xtc file into frameArray using
+ * libxdrfile's read_xtc function. When the requested frames are not contiguous
+ * (b > 0 or s > 1) we seek from one saved frame to the next with the frame
+ * index instead of reading the frames in between. Lastly we shrink frameArray
+ * and close the xd file pointer from libxdrfile's xdrfile_close.
+ */
+
+int Trajectory::read(int b, int s, int e)
+{
+    return read(b, s, e, "");
+}
+
+int Trajectory::read(int b, int s, int e, string groupName)
+{
+    int status = 0;
+
+    stopPrefetch();
+    setGroup(groupName);
+    this->nframes = 0;
+    frameArray.clear();
+    trrFrame.clear();
+    resetStore();
+
+    cout << endl;
+
+    try 
+    {
+
+        if (parts)
+        {
+            cout << "Reading in " << parts->GetNParts() << " xtc files: " << endl;
+        }
+        else
+        {
+            cout << "Reading in " << (trr ? "trr" : (cache ? "cache" : "xtc")) << " file: " << endl;
+        }
+        cout << "Starting frame: " << b << endl;
+
+        if (e == -1)
+        {
+            cout << "Reading to the end of the file." << endl;
+        }
+        else
+        {
+            cout << "Ending frame: " << e << endl;
+        }
+
+        if (s == 1)
+        {
+            cout << "Reading in every frame." << endl;
+        }
+        else if (s == 2)
+        {
+            cout << "Reading in every " << s << "nd frame." << endl;
+        }
+        else if (s == 3)
+        { 
+            cout << "Reading in every " << s << "rd frame." << endl;
+        }
+        else if (s >= 4)
+        {
+            cout << "Reading in every " << s << "th frame." << endl;
+        }
+
+        if (e <= b && e != -1)
+        {
+            cout << "NOTE: No frames being saved! Last frame comes before or is equal to first frame in Trajectory call!" << endl;
+        }
+
+        /* Only frames that are a multiple of s are saved, so start at the first
+         * one at or after b. Frames in between are never read: when the next
+         * frame to save is not the next one in the file we seek straight to it
+         * using the frame index. */
+        int frame = b;
+        if (frame % s != 0)
+        {
+            frame += s - frame % s;
+        }
+
+        /* Size the storage for all frames to be read if we know how many
+         * there are. Otherwise it grows in blocks of about 64 MB, since e may
+         * be far past the end of the file. */
+        int expected = (64 << 20) / (sizeof(rvec) * savedAtoms() + 1) + 1;
+        int last = knownFrames();
+        if (last != -1)
+        {
+            if (e != -1 && e < last)
+            {
+                last = e;
+            }
+            expected = (last > frame) ? (last - frame + s - 1) / s : 0;
+            frameArray.reserve(expected);
+        }
+        else if (e != -1)
+        {
+            expected = min(expected, (e > frame) ? (e - frame + s - 1) / s : 0);
+        }
+        arena.Reset(savedAtoms(), expected);
+
+        /* Mapped frames are not decoded, so one thread is enough. */
+        if (nthreads > 1 && plainXtc())
+        {
+            readParallel(frame, s, e);
+        }
+        else
+        {
+            const int first = frame;
+            while (e == -1 || frame < e)
+            {
+                status = seekFrame(frame);
+                if (status != 0)
+                {
+                    break;
+                }
+                /* Every frame from here is read, so read ahead again after
+                 * seeking to the first one. */
+                if (frame == first && s == 1 && xd != NULL)
+                {
+                    xdrfile_advise(xd, xdrSEQUENTIAL);
+                }
+                status = readFrame();
+                if (status != 0)
+                {
+                    break;
+                }
+                printInfo();
+                frame += s;
+            }
+        }
+
+        close();
+    } 
+    catch (runtime_error &excpt) 
+    {
+        if (throwOnError)
+        {
+            throw;
+        }
+        cerr << endl << "Problem with creating Trajectory object." << endl;
+        terminate();
+    }
+    frameArray.shrink_to_fit();
+    return nframes;
+}
+
+int Trajectory::read_time(float b, float e, float dt)
+{
+    return read_time(b, e, dt, "");
+}
+
+/*
+ * Frames are picked by the time in their header, so no coordinates are
+ * decoded for frames that are not saved. When the time of every frame is
+ * already known (from a saved frame index, or a trr or cache file) the first
+ * and last frames are found by binary search. Otherwise the headers are read
+ * one at a time from the start of the file, stopping after e, which does not
+ * decode anything either.
+ */
+int Trajectory::read_time(float b, float e, float dt, string groupName)
+{
+    stopPrefetch();
+    setGroup(groupName);
+    this->nframes = 0;
+    frameArray.clear();
+    trrFrame.clear();
+    resetStore();
+
+    cout << endl;
+    cout << "Reading in frames from " << b << " ps to ";
+    if (e == -1)
+    {
+        cout << "the end of the file";
+    }
+    else
+    {
+        cout << e << " ps";
+    }
+    if (dt > 0)
+    {
+        cout << " every " << dt << " ps";
+    }
+    cout << "." << endl;
+
+    if (knownFrames() != -1 || frameIndex.initSaved(filename))
+    {
+        const int total = knownFrames();
+
+        /* The first frame at or after b, and the first one after e. */
+        int first = 0;
+        int last = total;
+        int hi = total;
+        while (first < hi)
+        {
+            const int mid = first + (hi - first) / 2;
+            if (frameTime(mid) < b)
+            {
+                first = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+        if (e != -1)
+        {
+            int lo = first;
+            while (lo < last)
+            {
+                const int mid = lo + (last - lo) / 2;
+                if (frameTime(mid) <= e)
+                {
+                    lo = mid + 1;
+                }
+                else
+                {
+                    last = mid;
+                }
+            }
+        }
+
+        if (last > first)
+        {
+            frameArray.reserve(last - first);
+        }
+        arena.Reset(savedAtoms(), max(last - first, 1));
+        for (int frame = first; frame < last; frame++)
+        {
+            if (!onTime(frameTime(frame), dt))
+            {
+                continue;
+            }
+            if (seekFrame(frame) != 0)
+            {
+                break;
+            }
+            if (frame == first && dt <= 0 && xd != NULL)
+            {
+                xdrfile_advise(xd, xdrSEQUENTIAL);
+            }
+            if (readFrame() != 0)
+            {
+                break;
+            }
+            printInfo();
+        }
+    }
+    else
+    {
+        arena.Reset(savedAtoms(), (64 << 20) / (sizeof(rvec) * savedAtoms() + 1) + 1);
+        int step;
+        float time;
+        matrix box;
+        int status = seekFrame(0);
+        while (status == 0)
+        {
+            const int64_t start = xdrfile_tell(xd);
+            if (skip_xtc(xd, natoms, &step, &time, box) != exdrOK || (e != -1 && time > e))
+            {
+                break;
+            }
+            if (time >= b && onTime(time, dt))
+            {
+                status = xdrfile_seek(xd, start, SEEK_SET) || readFrame();
+                printInfo();
+            }
+            else
+            {
+                ++count;
+            }
+        }
+    }
+
+    close();
+    frameArray.shrink_to_fit();
+    return nframes;
+}
+
+float Trajectory::frameTime(int frame) const
+{
+    if (parts)
+    {
+        return parts->GetTime(frame);
+    }
+    if (trr)
+    {
+        return trr->GetTime(frame);
+    }
+    if (cache)
+    {
+        return cache->GetTime(frame);
+    }
+    return frameIndex.GetTime(frame);
+}
+
+/*
+ * Times are only stored as floats, so a time counts as a multiple of dt if it
+ * is within 0.1% of dt of one.
+ */
+bool Trajectory::onTime(float time, float dt)
+{
+    if (dt <= 0)
+    {
+        return true;
+    }
+    return fabs(time - dt * round(time / dt)) <= 0.001 * dt;
+}
+
+void Trajectory::open(string filename)
+{
+    char *cfilename = const_cast<char*>(filename.c_str());
+    count = 0;
+    nframes = 0;
+    part = 0;
+
+    if (filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".trr") == 0)
+    {
+        cout << "Opening trr file " << filename << "...";
+        xd = NULL;
+        trr = make_shared<TrrFile>(filename);
+        natoms = trr->GetNAtoms();
+        cout << "OK (" << trr->GetNFrames() << " frames)" << endl;
+        cout << natoms << " particles are in the system." << endl;
+        return;
+    }
+
+    if (filename.compare(0, 4, "shm:") == 0 ||
+        (filename.size() > 6 && filename.compare(filename.size() - 6, 6, ".cache") == 0))
+    {
+        cout << "Opening cache " << (filename.compare(0, 4, "shm:") == 0 ? "in shared memory " : "file ") << filename << "...";
+        xd = NULL;
+        cache = make_shared<FrameCache>(filename);
+        natoms = cache->GetNAtoms();
+        cout << "OK (" << cache->GetNFrames() << " frames)" << endl;
+        cout << natoms << " particles are in the system." << endl;
+        return;
+    }
+
+    xd = xdrfile_open(cfilename, "rm");
+    cout << "Opening xtc file " << filename << "...";
+    if (read_xtc_natoms(cfilename, &natoms) != 0 || (parts && natoms != parts->GetNAtoms()))
+    {
+        if (xd != NULL)
+        {
+            xdrfile_close(xd);
+            xd = NULL;
+        }
+        throw runtime_error("Cannot open " + this->filename + ".");
+    }
+    cout << "OK" << endl;
+    cout << natoms << " particles are in the system." << endl;
+
+    return;
+}
+
+/*
+ * Frame boundaries come from the frame index, so each thread can open its own
+ * handle on the xtc file, seek to a frame and decode it independently of the
+ * others. Every frame is decoded into its own slot in frameArray so the order
+ * is the same as when reading serially. Each thread gets a contiguous block of
+ * frames, which keeps its reads sequential. When reading several files a
+ * thread opens the file of its next frame if it is not the one it has open,
+ * so threads mostly read different files.
+ */
+void Trajectory::readParallel(int b, int s, int e)
+{
+    if (!parts && (!frameIndex.IsLoaded() || frameIndex.IsStale()))
+    {
+        frameIndex.init(filename);
+    }
+
+    int last = parts ? parts->GetNFrames() : frameIndex.GetNFrames();
+    if (e != -1 && e < last)
+    {
+        last = e;
+    }
+    const int n = (last > b) ? (last - b + s - 1) / s : 0;
+    vector <int> status(n, -1);
+    frameArray.resize(n);
+
+    /* Storage is handed out in order here, so each frame is in its place in
+     * the arena no matter which thread decodes it. */
+    arena.Reset(savedAtoms(), n);
+    vector <shared_ptr <float> > dest(n);
+    for (int i = 0; i < n; i++)
+    {
+        dest[i] = arena.Next();
+    }
+
+    cout << "Reading " << n << " frames with " << nthreads << " threads." << endl;
+
+    #pragma omp parallel num_threads(nthreads)
+    {
+        XDRFILE *txd = NULL;
+        int tpart = -1;
+        vector <float> scratch(groupAtoms.empty() ? 0 : natoms * DIM);
+        float time;
+        float prec;
+        int step;
+        matrix box;
+
+        #pragma omp for schedule(static)
+        for (int i = 0; i < n; i++)
+        {
+            const int frame = b + i * s;
+            const int p = parts ? parts->GetPart(frame) : 0;
+            if (p != tpart)
+            {
+                if (txd != NULL)
+                {
+                    xdrfile_close(txd);
+                }
+                txd = xdrfile_open((parts ? parts->GetFilename(p) : filename).c_str(), "rm");
+                tpart = p;
+            }
+            rvec *x = (rvec*) (groupAtoms.empty() ? dest[i].get() : scratch.data());
+            if (txd == NULL ||
+                xdrfile_seek(txd, parts ? parts->GetOffset(frame) : frameIndex.GetOffset(frame), SEEK_SET) != 0 ||
+                read_xtc(txd, natoms, &step, &time, box, x, &prec) != exdrOK)
+            {
+                continue;
+            }
+            gather(x, groupAtoms, (rvec*) dest[i].get());
+            frameArray[i] = Frame(step, time, box, dest[i], savedAtoms());
+            status[i] = 0;
+        }
+
+        if (txd != NULL)
+        {
+            xdrfile_close(txd);
+        }
+    }
+
+    /* Like the serial reader, stop at the first frame that could not be read. */
+    nframes = 0;
+    while (nframes < n && status[nframes] == 0)
+    {
+        ++nframes;
+    }
+    frameArray.resize(nframes);
+
+    return;
+}
+
+void Trajectory::SetNumThreads(int n)
+{
+    if (n < 1)
+    {
+        throw runtime_error("Number of threads must be at least 1.");
+    }
+    nthreads = n;
+    return;
+}
+
+int Trajectory::read_next(int n)
+{
+    return read_next(n, "");
+}
+
+int Trajectory::read_next(int n, string groupName)
+{
+    setGroup(groupName);
+    frameArray.clear();
+    frameArray.reserve(n);
+    trrFrame.clear();
+    resetStore();
+    arena.Reset(savedAtoms(), n);
+    nframes = 0;
+    int status;
+
+    /* Frames are read one after another from here, whatever seek came
+     * before. */
+    if (xd != NULL)
+    {
+        xdrfile_advise(xd, xdrSEQUENTIAL);
+    }
+
+    if (prefetchDepth > 0 && plainXtc() && !parts)
+    {
+        if (!prefetcher)
+        {
+            prefetcher = make_shared<Prefetcher>(xd, natoms, groupAtoms, arena, prefetchDepth, count);
+        }
+        Frame frame;
+        for (int i = 0; i < n && prefetcher->pop(frame); i++)
+        {
+            frameArray.push_back(move(frame));
+            ++nframes;
+            ++count;
+        }
+        return nframes;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        status = readFrame();
+        if (status != 0)
+        {
+            break;
+        }
+    }
+    return nframes;
+}
+
+int Trajectory::skip_next(int n)
+{
+    if (n <= 0)
+    {
+        return 0;
+    }
+
+    /* Frames already decoded in the background are simply dropped. */
+    int dropped = 0;
+    if (prefetcher)
+    {
+        dropped = prefetcher->drop(n);
+        count += dropped;
+        if (dropped == n)
+        {
+            return n;
+        }
+    }
+
+    const int start = stopPrefetch() - dropped;
+
+    if (seekFrame(start + n) == 0)
+    {
+        return n;
+    }
+
+    /* Fewer than n frames are left, so go to the last one and skip past it. */
+    if (mappedFrames() != -1 || parts)
+    {
+        count = max(count, knownFrames());
+    }
+    else if (frameIndex.IsLoaded() && count < frameIndex.GetNFrames() &&
+        seekFrame(frameIndex.GetNFrames() - 1) == 0)
+    {
+        skipFrame();
+    }
+
+    return count - start;
+}
+
+FrameStream Trajectory::stream(int b, int s, int e)
+{
+    if (mappedFrames() != -1 || parts)
+    {
+        throw runtime_error("Streaming is only supported for a single xtc file.");
+    }
+    /* Only build the frame index if some frames are passed over. */
+    if ((b > 0 || s > 1) && !frameIndex.IsLoaded())
+    {
+        frameIndex.init(filename);
+    }
+    return FrameStream(filename, natoms, frameIndex.IsLoaded() ? &frameIndex : NULL, arena, b, s, e);
+}
+
+TrajectoryWindow Trajectory::window(int length, int b, string groupName)
+{
+    if (mappedFrames() != -1 || parts)
+    {
+        throw runtime_error("Windows are only supported for a single xtc file.");
+    }
+    if (b > 0 && !frameIndex.IsLoaded())
+    {
+        frameIndex.init(filename);
+    }
+    vector <int> atoms;
+    if (!groupName.empty())
+    {
+        atoms.resize(index.GetGroupSize(groupName));
+        for (size_t i = 0; i < atoms.size(); i++)
+        {
+            atoms[i] = index.GetLocation(groupName, i);
+        }
+    }
+    return TrajectoryWindow(filename, natoms, atoms, frameIndex.IsLoaded() ? &frameIndex : NULL, length, b);
+}
+
+int Trajectory::follow(function <bool(const Frame&)> callback, double timeout)
+{
+    return follow(callback, timeout, "");
+}
+
+/*
+ * The mapping of xd only covers the file as it was when it was opened, so new
+ * frames are read through stdio, which sees data appended to the file. A frame
+ * is only decoded once it can be skipped over completely; a frame still being
+ * written fails to skip, and we go back to its start and wait for the rest.
+ * Afterwards xd is opened again with stdio too, since the file may still be
+ * growing.
+ */
+int Trajectory::follow(function <bool(const Frame&)> callback, double timeout, string groupName)
+{
+    if (mappedFrames() != -1 || parts)
+    {
+        throw runtime_error("Following is only supported for a single xtc file.");
+    }
+    if (xd == NULL)
+    {
+        throw runtime_error(filename + " is already closed.");
+    }
+    seekFrame(stopPrefetch());
+    setGroup(groupName);
+
+    int64_t pos = xdrfile_tell(xd);
+    XDRFILE *fxd = xdrfile_open(filename.c_str(), "r");
+    if (fxd == NULL || xdrfile_seek(fxd, pos, SEEK_SET) != 0)
+    {
+        if (fxd != NULL)
+        {
+            xdrfile_close(fxd);
+        }
+        throw runtime_error("Cannot open " + filename + ".");
+    }
+    FileWatch watch(filename);
+
+    /* Frames are decoded into the same buffer unless the callback kept the
+     * last frame. */
+    const int nsaved = savedAtoms();
+    shared_ptr <float> dest;
+    vector <float> all(groupAtoms.empty() ? 0 : natoms * DIM);
+
+    int nfollowed = 0;
+    auto last = chrono::steady_clock::now();
+    while (true)
+    {
+        int step;
+        float time;
+        float prec;
+        matrix box;
+        pos = xdrfile_tell(fxd);
+        if (skip_xtc(fxd, natoms, &step, &time, box) == exdrOK && xdrfile_seek(fxd, pos, SEEK_SET) == 0)
+        {
+            if (!dest || dest.use_count() > 1)
+            {
+                dest = shared_ptr <float> (new float[nsaved * DIM], default_delete<float[]>());
+            }
+            rvec *x = (rvec*) (groupAtoms.empty() ? dest.get() : all.data());
+            if (read_xtc(fxd, natoms, &step, &time, box, x, &prec) != exdrOK)
+            {
+                break;
+            }
+            gather(x, groupAtoms, (rvec*) dest.get());
+            ++nfollowed;
+            ++count;
+            last = chrono::steady_clock::now();
+            if (!callback(Frame(step, time, box, dest, nsaved)))
+            {
+                pos = xdrfile_tell(fxd);
+                break;
+            }
+            continue;
+        }
+
+        xdrfile_seek(fxd, pos, SEEK_SET);
+        const double waited = chrono::duration<double>(chrono::steady_clock::now() - last).count();
+        if (timeout >= 0 && waited >= timeout)
+        {
+            break;
+        }
+        /* Look at the file at least once a second, in case the watch missed
+         * a write (e.g. one made on another machine to a network file
+         * system). */
+        const double left = (timeout >= 0) ? timeout - waited : 1.0;
+        watch.wait(max(1, (int) (min(left, 1.0) * 1000)));
+    }
+    xdrfile_close(fxd);
+
+    xdrfile_close(xd);
+    xd = xdrfile_open(filename.c_str(), "r");
+    if (xd == NULL || xdrfile_seek(xd, pos, SEEK_SET) != 0)
+    {
+        throw runtime_error("Cannot open " + filename + ".");
+    }
+    return nfollowed;
+}
+
+void Trajectory::SetHugePages(bool on)
+{
+    arena.SetHugePages(on);
+    return;
+}
+
+void Trajectory::SetCompressedStore(int cacheFrames)
+{
+    if (cacheFrames < 0)
+    {
+        throw runtime_error("Number of decoded frames kept cannot be negative.");
+    }
+    storeFrames = cacheFrames;
+    return;
+}
+
+/*
+ * Each read starts a new store, so copies of this Trajectory made before keep
+ * the frames they had.
+ */
+void Trajectory::resetStore()
+{
+    store.reset();
+    if (mappedFrames() != -1)
+    {
+        return;
+    }
+    if (memoryBudget > 0)
+    {
+        const size_t frameBytes = sizeof(rvec) * savedAtoms();
+        store = make_shared<FrameStore>(filename, natoms, groupAtoms, memoryBudget / frameBytes, READAHEAD_FRAMES);
+    }
+    else if (storeFrames > 0)
+    {
+        store = make_shared<FrameStore>(natoms, groupAtoms, storeFrames);
+    }
+    return;
+}
+
+void Trajectory::SetMemoryBudget(size_t bytes)
+{
+    if (parts)
+    {
+        throw runtime_error("A memory budget is only supported for a single xtc file.");
+    }
+    memoryBudget = bytes;
+    return;
+}
+
+void Trajectory::SetQuantized(bool on)
+{
+    quantized = on;
+    return;
+}
+
+void Trajectory::SetThrowOnError(bool on)
+{
+    throwOnError = on;
+    return;
+}
+
+int Trajectory::knownFrames() const
+{
+    if (mappedFrames() != -1)
+    {
+        return mappedFrames();
+    }
+    if (parts)
+    {
+        return parts->GetNFrames();
+    }
+    return frameIndex.IsLoaded() ? frameIndex.GetNFrames() : -1;
+}
+
+bool Trajectory::plainXtc() const
 {
-    PrintBanner();
-    this->filename = filename;
-    open(filename);
+    return mappedFrames() == -1 && !store && !quantized;
 }
 
-Trajectory::Trajectory(string filename, string ndxfile)
+void Trajectory::SetPrefetch(int depth)
 {
-    PrintBanner();
-    Index index(ndxfile);
-    this->index=index;
-    this->filename = filename;
-    open(filename);
+    if (depth < 0)
+    {
+        throw runtime_error("Prefetch depth cannot be negative.");
+    }
+    /* Go back to the first frame not yet returned by read_next. */
+    seekFrame(stopPrefetch());
+    prefetchDepth = depth;
+    return;
 }
 
-Trajectory::Trajectory(string filename, Index index)
+int Trajectory::stopPrefetch()
 {
-    PrintBanner();
-    this->index=index;
-    this->filename = filename;
-    open(filename);
+    const int at = count;
+    if (prefetcher)
+    {
+        count = prefetcher->stop();
+        prefetcher.reset();
+    }
+    return at;
 }
 
 /*
- * Initializes the trajectory object by finding out how many atoms are in the
- * system, saving how many frames we think there might be for memory allocation.
- * Reads in all of the frames from the xtc file. First, we resize frameArray to
- * a it's initial size. Then we read in the xtc file frame by frame using
- * libxdrfile's read_xtc function. We set the relevant data at each frame. If
- * there are more frames left to read in but our vector wasn't large enough we
- * warn the user (although we could do a resize, the user is allowed to choose a
- * smaller number of frames and may not want them). Lastly we resize frameArray
- * and close the xd file pointer from libxdrfile's xdrfile_close.
+ * Moves the file position to the start of a frame. Nothing needs to happen if
+ * we are already there, which is the case for every sequential read. Otherwise
+ * the frame index is loaded (or built) the first time it is needed, and
+ * reloaded if the xtc file has changed and the frame is past the end of it.
  */
-
-int Trajectory::read(int b, int s, int e)
+int Trajectory::seekFrame(int frame)
 {
-    int status = 0;
-    this->count = 0;
-
-    this->nframes = 0;
-
-    cout << endl;
-
-    try 
+    /* Every file is indexed when reading several, but reaching the end of one
+     * means opening the next, even if the frame is the next one. */
+    if (parts)
     {
-
-        cout << "Reading in xtc file: " << endl;
-        cout << "Starting frame: " << b << endl;
-
-        if (e == -1)
+        if (frame < 0 || frame >= parts->GetNFrames())
         {
-            cout << "Reading to the end of the file." << endl;
+            return -1;
         }
-        else
+        const int p = parts->GetPart(frame);
+        if (p == part && frame == count)
         {
-            cout << "Ending frame: " << e << endl;
+            return 0;
         }
-
-        if (s == 1)
+        if (p != part)
         {
-            cout << "Reading in every frame." << endl;
+            if (xd != NULL)
+            {
+                xdrfile_close(xd);
+            }
+            xd = xdrfile_open(parts->GetFilename(p).c_str(), "rm");
+            if (xd == NULL)
+            {
+                throw runtime_error("Cannot open " + parts->GetFilename(p) + ".");
+            }
+            part = p;
         }
-        else if (s == 2)
+        else if (frame != count && frame != count + 1)
         {
-            cout << "Reading in every " << s << "nd frame." << endl;
-        }
-        else if (s == 3)
-        { 
-            cout << "Reading in every " << s << "rd frame." << endl;
+            xdrfile_advise(xd, xdrRANDOM);
         }
-        else if (s >= 4)
+        if (xdrfile_seek(xd, parts->GetOffset(frame), SEEK_SET) != 0)
         {
-            cout << "Reading in every " << s << "th frame." << endl;
+            return -1;
         }
+        count = frame;
+        return 0;
+    }
 
-        if (e <= b && e != -1)
-        {
-            cout << "NOTE: No frames being saved! Last frame comes before or is equal to first frame in Trajectory call!" << endl;
-        }
+    if (frame == count)
+    {
+        return 0;
+    }
 
-        for (int i = 0; i < b; ++i)
+    /* Every frame of a trr or cache file is already mapped, so there is
+     * nothing to move. */
+    if (mappedFrames() != -1)
+    {
+        if (frame < 0 || frame >= mappedFrames())
         {
-            status = skipFrame();
-            if (status != 0)
-            {
-                break;
-            }
-            ++count;
-            printInfo();
+            return -1;
         }
+        count = frame;
+        return 0;
+    }
 
-        if (e == -1)
+    /* The first frame is at the start of the file, index or not. */
+    if (frame == 0 && !frameIndex.IsLoaded())
+    {
+        if (xdrfile_seek(xd, 0, SEEK_SET) != 0)
         {
-            while (status == 0) 
-            {
-                if (count % s == 0)
-                {
-                    status = readFrame();
-                }
-                else
-                {
-                    status = skipFrame();
-                }
-                ++count;
-                printInfo();
-            }
+            return -1;
         }
-        else
-        {
-            frameArray.reserve(e/s);
-            while (status == 0) 
-            {
-                if (count % s == 0)
-                {
-                    status = readFrame();
-                }
-                else
-                {
-                    status = skipFrame();
-                }
-                ++count;
+        count = 0;
+        return 0;
+    }
 
-                if (count >= e)
-                {
-                    break;
-                }
-                printInfo();
+    if (!frameIndex.IsLoaded() ||
+        (frame >= frameIndex.GetNFrames() && frameIndex.IsStale()))
+    {
+        frameIndex.init(filename);
+    }
 
-            }
-        }
+    if (frame < 0 || frame >= frameIndex.GetNFrames())
+    {
+        return -1;
+    }
 
-        close();
-    } 
-    catch (runtime_error &excpt) 
+    if (xdrfile_seek(xd, frameIndex.GetOffset(frame), SEEK_SET) != 0)
     {
-        cerr << endl << "Problem with creating Trajectory object." << endl;
-        terminate();
+        return -1;
     }
-    frameArray.shrink_to_fit();
-    return nframes;
+    /* Readahead only wastes time once we start jumping around. */
+    if (frame != count + 1)
+    {
+        xdrfile_advise(xd, xdrRANDOM);
+    }
+    count = frame;
+
+    return 0;
 }
 
-void Trajectory::open(string filename)
+int Trajectory::readFrame()
 {
-    char cfilename[200];
+    float time;
+    float prec;
+    int status;
+    int step;
+    matrix box;
 
-    for (unsigned int i = 0; i < filename.size(); ++i)
+    if (trr)
     {
-        cfilename[i] = filename[i];
+        if (count >= trr->GetNFrames())
+        {
+            return -1;
+        }
+        /* Frames with only velocities or forces are kept too, with positions
+         * that are not numbers. */
+        shared_ptr <float> dest = arena.Next();
+        if (trr->HasPositions(count))
+        {
+            trr->GetPositions(count, groupAtoms, (rvec*) dest.get());
+        }
+        else
+        {
+            fill(dest.get(), dest.get() + savedAtoms() * DIM, numeric_limits<float>::quiet_NaN());
+        }
+        trr->GetBox(count, box);
+        step = trr->GetStep(count);
+        time = trr->GetTime(count);
+        frameArray.push_back(Frame(step, time, box, dest, savedAtoms()));
+        trrFrame.push_back(count);
+        ++nframes;
+        ++count;
+        return 0;
     }
-    cfilename[filename.size()] = '\0';
-    xd = xdrfile_open(cfilename, "r");
-    cout << "Opening xtc file " << filename << "...";
-    if (read_xtc_natoms(cfilename, &natoms) != 0)
+
+    /* Frames with all atoms point straight into the cache file. */
+    if (cache)
     {
-        throw runtime_error("Cannot open " + this->filename + ".");
+        if (count >= cache->GetNFrames())
+        {
+            return -1;
+        }
+        shared_ptr <float> dest = cache->GetXYZ(count);
+        if (!groupAtoms.empty())
+        {
+            shared_ptr <float> all = dest;
+            dest = arena.Next();
+            gather((const rvec*) all.get(), groupAtoms, (rvec*) dest.get());
+        }
+        cache->GetBox(count, box);
+        step = cache->GetStep(count);
+        time = cache->GetTime(count);
+        frameArray.push_back(Frame(step, time, box, dest, savedAtoms()));
+        ++nframes;
+        ++count;
+        return 0;
     }
-    cout << "OK" << endl;
-    cout << natoms << " particles are in the system." << endl;
 
-    return;
-}
+    if (parts && seekFrame(count) != 0)
+    {
+        return -1;
+    }
 
-int Trajectory::read_next(int n)
-{
-    frameArray.clear();
-    frameArray.reserve(n);
-    nframes = 0;
-    int status;
-    for (int i = 0; i < n; i++)
+    /* Only the compressed frame is kept; it is decoded when used. */
+    if (store)
     {
-        status = readFrame();
-        if (status != 0)
+        if (store->Add(xd, &step, &time, box) != 0)
         {
-            break;
+            return -1;
         }
+        frameArray.push_back(Frame(step, time, box, shared_ptr <float> (), savedAtoms()));
+        ++nframes;
+        ++count;
+        return 0;
     }
-    return nframes;
-}
 
-int Trajectory::skip_next(int n)
-{
-    int status;
-    for (int i = 0; i < n; i++)
+    /* Small systems are stored as floats, so there are no integers to keep. */
+    if (quantized && natoms > 9)
     {
-        status = skipFrame();
-        if (status != 0)
+        qscratch.resize(natoms * DIM);
+        if (read_xtc_int(xd, natoms, &step, &time, box, qscratch.data(), &prec) != exdrOK)
         {
-            break;
+            return -1;
         }
+        frameArray.push_back(Frame(step, time, box, qscratch.data(), prec, natoms, groupAtoms));
+        ++nframes;
+        ++count;
+        return 0;
     }
-    return nframes;
-}
 
-int Trajectory::readFrame()
-{
-    float time;
-    float prec;
-    int status;
-    int step;
-    matrix box;
-    rvec x[natoms];
+    shared_ptr <float> dest = arena.Next();
+    rvec *x = (rvec*) dest.get();
+
+    if (!groupAtoms.empty())
+    {
+        scratch.resize(natoms * DIM);
+        x = (rvec*) scratch.data();
+    }
 
-    status = read_xtc(xd, natoms, &step, &time, box, &x[0], &prec);
+    status = read_xtc(xd, natoms, &step, &time, box, x, &prec);
 
     if (status != 0) 
     {
         return -1;
     }
 
-    frameArray.push_back(Frame(step, time, box, x, natoms));
+    gather(x, groupAtoms, (rvec*) dest.get());
+    frameArray.push_back(Frame(step, time, box, dest, savedAtoms()));
     ++nframes;
+    ++count;
 
     return 0;
 }
@@ -261,18 +1354,32 @@ int Trajectory::readFrame()
 int Trajectory::skipFrame()
 {
     float time;
-    float prec;
     int status;
     int step;
     matrix box;
-    rvec x[natoms];
 
-    status = read_xtc(xd, natoms, &step, &time, box, &x[0], &prec);
+    if (mappedFrames() != -1)
+    {
+        if (count >= mappedFrames())
+        {
+            return -1;
+        }
+        ++count;
+        return 0;
+    }
+
+    if (parts && seekFrame(count) != 0)
+    {
+        return -1;
+    }
+
+    status = skip_xtc(xd, natoms, &step, &time, box);
 
     if (status != 0) 
     {
         return -1;
     }
+    ++count;
 
     return 0;
 }
@@ -289,9 +1396,15 @@ void Trajectory::printInfo()
 
 void Trajectory::close()
 {
+    stopPrefetch();
+    if (xd == NULL)
+    {
+        return;
+    }
     try 
     {
         xdrfile_close(xd);
+        xd = NULL;
     }
     catch(int e)
     {
@@ -306,26 +1419,177 @@ void Trajectory::close()
 // Gets the xyz coordinates when the frame and atom number are specified.
 coordinates Trajectory::GetXYZ(int frame, int atom) const
 {
-    return frameArray[frame].GetXYZ(atom);
+    Frame hold;
+    return frameAt(frame, hold).GetXYZ(storedAtom(atom));
 }
 
 // Gets the xyz coordinates for the entire frame.
 vector <coordinates> Trajectory::GetXYZ(int frame) const
 {
-    return frameArray[frame].GetXYZ();
+    Frame hold;
+    return frameAt(frame, hold).GetXYZ();
 }
 
 // Gets the xyz coordinates for an entire group.
 vector <coordinates> Trajectory::GetXYZ(int frame, string groupName) const
 {
-    return frameArray[frame].GetXYZ(index, groupName);
+    Frame hold;
+    const Frame &f = frameAt(frame, hold);
+    if (groupAtoms.empty())
+    {
+        return f.GetXYZ(index, groupName);
+    }
+    if (groupName == loadedGroup)
+    {
+        return f.GetXYZ();
+    }
+    const int grp_size = index.GetGroupSize(groupName);
+    vector <coordinates> xyz(grp_size);
+    for (int atom = 0; atom < grp_size; ++atom)
+    {
+        xyz[atom] = f.GetXYZ(location(groupName, atom));
+    }
+    return xyz;
 }
 
 // Gets the xyz coordinates when the frame, group, and atom number are
 // specified.
 coordinates Trajectory::GetXYZ(int frame, string group, int atom) const
 {
-    return frameArray[frame].GetXYZ(index.GetLocation(group, atom));
+    Frame hold;
+    return frameAt(frame, hold).GetXYZ(location(group, atom));
+}
+
+/*
+ * Frames kept compressed are decoded (or found among those kept decoded) into
+ * hold, which keeps the coordinates alive while the caller uses them even if
+ * another thread makes the store drop them. Otherwise this is just the frame.
+ */
+const Frame& Trajectory::frameAt(int frame, Frame &hold) const
+{
+    if (!store)
+    {
+        return frameArray[frame];
+    }
+    hold = Frame(frameArray.at(frame), store->Get(frame));
+    return hold;
+}
+
+/*
+ * When only an index group was read in, atom i of each saved frame is atom
+ * groupAtoms[i] of the system. These give where an atom is saved.
+ */
+int Trajectory::storedAtom(int atom) const
+{
+    if (groupAtoms.empty())
+    {
+        return atom;
+    }
+    const int stored = storedLocation.at(atom);
+    if (stored < 0)
+    {
+        throw runtime_error("Tried to access an atom which is not in group " + loadedGroup + ", the only group read in.");
+    }
+    return stored;
+}
+
+int Trajectory::savedAtoms() const
+{
+    return groupAtoms.empty() ? natoms : groupAtoms.size();
+}
+
+int Trajectory::location(string groupName, int atom) const
+{
+    if (!groupAtoms.empty() && groupName == loadedGroup)
+    {
+        return atom;
+    }
+    return storedAtom(index.GetLocation(groupName, atom));
+}
+
+/*
+ * Sets which atoms are saved in each frame: all of them if groupName is
+ * empty, otherwise only those in the index group.
+ */
+void Trajectory::setGroup(string groupName)
+{
+    if (groupName == loadedGroup)
+    {
+        return;
+    }
+    /* Go back to the first frame not yet returned by read_next. */
+    seekFrame(stopPrefetch());
+    loadedGroup = groupName;
+    groupAtoms.clear();
+    storedLocation.clear();
+    if (groupName.empty())
+    {
+        vector <float> ().swap(scratch);
+        return;
+    }
+    const int grp_size = index.GetGroupSize(groupName);
+    groupAtoms.resize(grp_size);
+    storedLocation.assign(natoms, -1);
+    for (int i = 0; i < grp_size; ++i)
+    {
+        groupAtoms[i] = index.GetLocation(groupName, i);
+        storedLocation.at(groupAtoms[i]) = i;
+    }
+    cout << "Saving only the " << grp_size << " atoms in group " << groupName << "." << endl;
+    return;
+}
+
+int Trajectory::mappedFrames() const
+{
+    if (trr)
+    {
+        return trr->GetNFrames();
+    }
+    if (cache)
+    {
+        return cache->GetNFrames();
+    }
+    return -1;
+}
+
+int Trajectory::trrFrameOf(int frame) const
+{
+    if (!trr)
+    {
+        throw runtime_error("Velocities and forces are only in trr files.");
+    }
+    return trrFrame.at(frame);
+}
+
+bool Trajectory::HasPositions(int frame) const
+{
+    if (!trr)
+    {
+        return true;
+    }
+    return trr->HasPositions(trrFrameOf(frame));
+}
+
+coordinates Trajectory::GetVelocity(int frame, int atom) const
+{
+    const int f = trrFrameOf(frame);
+    return trr->GetVelocity(f, atom);
+}
+
+coordinates Trajectory::GetVelocity(int frame, string groupName, int atom) const
+{
+    return GetVelocity(frame, index.GetLocation(groupName, atom));
+}
+
+coordinates Trajectory::GetForce(int frame, int atom) const
+{
+    const int f = trrFrameOf(frame);
+    return trr->GetForce(f, atom);
+}
+
+coordinates Trajectory::GetForce(int frame, string groupName, int atom) const
+{
+    return GetForce(frame, index.GetLocation(groupName, atom));
 }
 
 triclinicbox Trajectory::GetBox(int frame) const
@@ -375,7 +1639,8 @@ string Trajectory::GetFilename() const
 
 void Trajectory::CenterAtoms(int frame) const
 {
-    frameArray[frame].CenterAtoms();
+    Frame hold;
+    frameAt(frame, hold).CenterAtoms();
     return;
 }
 
@@ -396,56 +1661,83 @@ void Trajectory::PrintBanner() const
 
 coordinates4 Trajectory::GetXYZ4(int frame, int atom) const
 {
-    return frameArray[frame].GetXYZ4(atom);
+    Frame hold;
+    const Frame &f = frameAt(frame, hold);
+    if (groupAtoms.empty())
+    {
+        return f.GetXYZ4(atom);
+    }
+    return f.GetXYZ4(storedAtom(atom),
+                     storedAtom(atom+1),
+                     storedAtom(atom+2),
+                     storedAtom(atom+3));
 }
 
 coordinates8 Trajectory::GetXYZ8(int frame, int atom) const
 {
-    return frameArray[frame].GetXYZ8(atom);
+    Frame hold;
+    const Frame &f = frameAt(frame, hold);
+    if (groupAtoms.empty())
+    {
+        return f.GetXYZ8(atom);
+    }
+    return f.GetXYZ8(storedAtom(atom),
+                     storedAtom(atom+1),
+                     storedAtom(atom+2),
+                     storedAtom(atom+3),
+                     storedAtom(atom+4),
+                     storedAtom(atom+5),
+                     storedAtom(atom+6),
+                     storedAtom(atom+7));
 }
 
 coordinates8 Trajectory::GetXYZ8F(int frame, int atom) const
 {
-    return  (coordinates8 (frameArray[frame].GetXYZ(atom),
-                           frameArray[frame+1].GetXYZ(atom),
-                           frameArray[frame+2].GetXYZ(atom),
-                           frameArray[frame+3].GetXYZ(atom),
-                           frameArray[frame+4].GetXYZ(atom),
-                           frameArray[frame+5].GetXYZ(atom),
-                           frameArray[frame+6].GetXYZ(atom),
-                           frameArray[frame+7].GetXYZ(atom)) );
+    Frame hold[8];
+    atom = storedAtom(atom);
+    return  (coordinates8 (frameAt(frame, hold[0]).GetXYZ(atom),
+                           frameAt(frame+1, hold[1]).GetXYZ(atom),
+                           frameAt(frame+2, hold[2]).GetXYZ(atom),
+                           frameAt(frame+3, hold[3]).GetXYZ(atom),
+                           frameAt(frame+4, hold[4]).GetXYZ(atom),
+                           frameAt(frame+5, hold[5]).GetXYZ(atom),
+                           frameAt(frame+6, hold[6]).GetXYZ(atom),
+                           frameAt(frame+7, hold[7]).GetXYZ(atom)) );
 }
 
 coordinates4 Trajectory::GetXYZ4(int frame, string group, int atom) const
 {
-    return frameArray[frame].GetXYZ4(index.GetLocation(group, atom),
-                                     index.GetLocation(group, atom+1),
-                                     index.GetLocation(group, atom+2),
-                                     index.GetLocation(group, atom+3));
+    Frame hold;
+    return frameAt(frame, hold).GetXYZ4(location(group, atom),
+                                        location(group, atom+1),
+                                        location(group, atom+2),
+                                        location(group, atom+3));
 }
 
 coordinates8 Trajectory::GetXYZ8(int frame, string group, int atom) const
 {
-    return frameArray[frame].GetXYZ8(index.GetLocation(group, atom),
-                                     index.GetLocation(group, atom+1),
-                                     index.GetLocation(group, atom+2),
-                                     index.GetLocation(group, atom+3),
-                                     index.GetLocation(group, atom+4),
-                                     index.GetLocation(group, atom+5),
-                                     index.GetLocation(group, atom+6),
-                                     index.GetLocation(group, atom+7));
+    Frame hold;
+    return frameAt(frame, hold).GetXYZ8(location(group, atom),
+                                        location(group, atom+1),
+                                        location(group, atom+2),
+                                        location(group, atom+3),
+                                        location(group, atom+4),
+                                        location(group, atom+5),
+                                        location(group, atom+6),
+                                        location(group, atom+7));
 }
 
 coordinates8 Trajectory::GetXYZ8F(int frame, string group, int atom) const
 {
-    return ( coordinates8 (frameArray[frame].GetXYZ(index.GetLocation(group, atom)),
-                           frameArray[frame+1].GetXYZ(index.GetLocation(group, atom)),
-                           frameArray[frame+2].GetXYZ(index.GetLocation(group, atom)),
-                           frameArray[frame+3].GetXYZ(index.GetLocation(group, atom)),
-                           frameArray[frame+4].GetXYZ(index.GetLocation(group, atom)),
-                           frameArray[frame+5].GetXYZ(index.GetLocation(group, atom)),
-                           frameArray[frame+6].GetXYZ(index.GetLocation(group, atom)),
-                           frameArray[frame+7].GetXYZ(index.GetLocation(group, atom))) );
+    Frame hold[8];
+    return ( coordinates8 (frameAt(frame, hold[0]).GetXYZ(location(group, atom)),
+                           frameAt(frame+1, hold[1]).GetXYZ(location(group, atom)),
+                           frameAt(frame+2, hold[2]).GetXYZ(location(group, atom)),
+                           frameAt(frame+3, hold[3]).GetXYZ(location(group, atom)),
+                           frameAt(frame+4, hold[4]).GetXYZ(location(group, atom)),
+                           frameAt(frame+5, hold[5]).GetXYZ(location(group, atom)),
+                           frameAt(frame+6, hold[6]).GetXYZ(location(group, atom)),
+                           frameAt(frame+7, hold[7]).GetXYZ(location(group, atom))) );
 
 }
 
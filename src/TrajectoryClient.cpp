@@ -0,0 +1,322 @@
+/*
+ * libgmxcpp
+ * Copyright (C) 2015 James W. Barnett <jbarnet4@tulane.edu>
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The full license is located in a text file titled "LICENSE" in the root
+ * directory of the source.
+ *
+ */
+
+/**
+ * @file
+ * @brief TrajectoryClient class
+ * @see TrajectoryClient.h
+ */
+
+#include "gmxcpp/TrajectoryClient.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifdef MSG_NOSIGNAL
+static const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+static const int SEND_FLAGS = 0;
+#endif
+
+static bool sendAll(int fd, const void *buf, size_t size)
+{
+    const char *p = (const char*) buf;
+    while (size > 0)
+    {
+        ssize_t n = send(fd, p, size, SEND_FLAGS);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool recvAll(int fd, void *buf, size_t size)
+{
+    char *p = (char*) buf;
+    while (size > 0)
+    {
+        ssize_t n = recv(fd, p, size, 0);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+/* Gets a reply, and the file descriptor passed along with it if there is one
+ * (otherwise -1). */
+static bool recvReply(int fd, ServerReply *reply, int *passfd)
+{
+    iovec iov;
+    iov.iov_base = reply;
+    iov.iov_len = sizeof(*reply);
+
+    char control[CMSG_SPACE(sizeof(int))];
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t n;
+    do
+    {
+        n = recvmsg(fd, &msg, 0);
+    }
+    while (n < 0 && errno == EINTR);
+    if (n <= 0)
+    {
+        return false;
+    }
+
+    *passfd = -1;
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+    {
+        memcpy(passfd, CMSG_DATA(cmsg), sizeof(int));
+    }
+    return recvAll(fd, (char*) reply + n, sizeof(*reply) - n);
+}
+
+/* The server may have been started somewhere else, so it is sent the full
+ * path of each file. */
+static string fullPath(const string &file)
+{
+    char path[PATH_MAX];
+    if (file.empty() || file.compare(0, 4, "shm:") == 0 || realpath(file.c_str(), path) == NULL)
+    {
+        return file;
+    }
+    return path;
+}
+
+TrajectoryClient::TrajectoryClient(string socketPath, string xtcfile, string ndxfile)
+{
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socketPath.empty() || socketPath.size() >= sizeof(addr.sun_path))
+    {
+        throw runtime_error("Cannot use " + socketPath + " as a socket.");
+    }
+    strcpy(addr.sun_path, socketPath.c_str());
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (sockaddr*) &addr, sizeof(addr)) != 0)
+    {
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        throw runtime_error("Cannot connect to a trajectory server on " + socketPath + ".");
+    }
+
+    handle = -1;
+    xyzFrame = -1;
+    xyzCount = 0;
+    infoFrame = -1;
+
+    string names = fullPath(xtcfile);
+    if (!ndxfile.empty())
+    {
+        names += '\0' + fullPath(ndxfile);
+    }
+    try
+    {
+        ServerReply reply = request(ServerRequest::Open, 0, names);
+        handle = reply.handle;
+        natoms = reply.natoms;
+        nframes = reply.nframes;
+    }
+    catch (runtime_error &excpt)
+    {
+        ::close(fd);
+        throw;
+    }
+}
+
+TrajectoryClient::~TrajectoryClient()
+{
+    ::close(fd);
+}
+
+ServerReply TrajectoryClient::request(int op, int frame, const string &text)
+{
+    ServerRequest req;
+    req.op = op;
+    req.handle = handle;
+    req.frame = frame;
+    req.length = text.size();
+
+    ServerReply reply;
+    int passfd;
+    if (!sendAll(fd, &req, sizeof(req)) || !sendAll(fd, text.data(), text.size()) ||
+        !recvReply(fd, &reply, &passfd))
+    {
+        throw runtime_error("Lost the connection to the trajectory server.");
+    }
+
+    if (passfd >= 0)
+    {
+        struct stat st;
+        void *p = (fstat(passfd, &st) == 0) ? mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, passfd, 0) : MAP_FAILED;
+        ::close(passfd);
+        if (p == MAP_FAILED)
+        {
+            throw runtime_error("Cannot map the shared memory of the trajectory server.");
+        }
+        const size_t size = st.st_size;
+        region = shared_ptr <float> ((float*) p, [size](float *p) { munmap(p, size); });
+    }
+
+    if (reply.status != 0)
+    {
+        string message(max(reply.length, 0), '\0');
+        if (!recvAll(fd, &message[0], message.size()))
+        {
+            throw runtime_error("Lost the connection to the trajectory server.");
+        }
+        throw runtime_error(message);
+    }
+    return reply;
+}
+
+void TrajectoryClient::fetchInfo(int frame)
+{
+    if (frame != infoFrame)
+    {
+        info = request(ServerRequest::Info, frame, "");
+        infoFrame = frame;
+    }
+    return;
+}
+
+void TrajectoryClient::fetch(int frame, const string &groupName)
+{
+    if (frame != xyzFrame || groupName != xyzGroup)
+    {
+        /* Until the reply comes, the shared memory may hold neither. */
+        xyzFrame = -1;
+        info = request(ServerRequest::Coordinates, frame, groupName);
+        infoFrame = frame;
+        xyzFrame = frame;
+        xyzGroup = groupName;
+        xyzCount = info.count;
+    }
+    return;
+}
+
+coordinates TrajectoryClient::get(int atom) const
+{
+    if (atom < 0 || atom >= xyzCount)
+    {
+        throw runtime_error("Atom " + to_string(atom) + " is not in " + (xyzGroup.empty() ? "the system" : "group " + xyzGroup) + ".");
+    }
+    const float *p = region.get() + DIM * atom;
+    return coordinates(p[X], p[Y], p[Z]);
+}
+
+int TrajectoryClient::GetNAtoms() const
+{
+    return natoms;
+}
+
+int TrajectoryClient::GetNAtoms(string groupName)
+{
+    return request(ServerRequest::GroupSize, 0, groupName).count;
+}
+
+int TrajectoryClient::GetNFrames() const
+{
+    return nframes;
+}
+
+float TrajectoryClient::GetTime(int frame)
+{
+    fetchInfo(frame);
+    return info.time;
+}
+
+int TrajectoryClient::GetStep(int frame)
+{
+    fetchInfo(frame);
+    return info.step;
+}
+
+triclinicbox TrajectoryClient::GetBox(int frame)
+{
+    fetchInfo(frame);
+    return triclinicbox(info.box[X][X], info.box[X][Y], info.box[X][Z],
+                        info.box[Y][X], info.box[Y][Y], info.box[Y][Z],
+                        info.box[Z][X], info.box[Z][Y], info.box[Z][Z]);
+}
+
+coordinates TrajectoryClient::GetXYZ(int frame, int atom)
+{
+    fetch(frame, "");
+    return get(atom);
+}
+
+coordinates TrajectoryClient::GetXYZ(int frame, string groupName, int atom)
+{
+    fetch(frame, groupName);
+    return get(atom);
+}
+
+vector <coordinates> TrajectoryClient::GetXYZ(int frame)
+{
+    return GetXYZ(frame, "");
+}
+
+vector <coordinates> TrajectoryClient::GetXYZ(int frame, string groupName)
+{
+    fetch(frame, groupName);
+    vector <coordinates> xyz(xyzCount);
+    for (int atom = 0; atom < xyzCount; atom++)
+    {
+        xyz[atom] = get(atom);
+    }
+    return xyz;
+}
@@ -0,0 +1,436 @@
+/*
+ * libgmxcpp
+ * Copyright (C) 2015 James W. Barnett <jbarnet4@tulane.edu>
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The full license is located in a text file titled "LICENSE" in the root
+ * directory of the source.
+ *
+ */
+
+/**
+ * @file
+ * @brief TrajectoryServer class
+ * @see TrajectoryServer.h
+ */
+
+#include "gmxcpp/TrajectoryServer.h"
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifdef MSG_NOSIGNAL
+static const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+static const int SEND_FLAGS = 0;
+#endif
+
+/* Longest text accepted with a request. */
+static const int32_t MAX_TEXT = 1 << 16;
+
+static bool sendAll(int fd, const void *buf, size_t size)
+{
+    const char *p = (const char*) buf;
+    while (size > 0)
+    {
+        ssize_t n = send(fd, p, size, SEND_FLAGS);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool recvAll(int fd, void *buf, size_t size)
+{
+    char *p = (char*) buf;
+    while (size > 0)
+    {
+        ssize_t n = recv(fd, p, size, 0);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+/* Sends a reply, passing a file descriptor along with it if one is given. */
+static bool sendReply(int fd, const ServerReply &reply, int passfd)
+{
+    iovec iov;
+    iov.iov_base = (void*) &reply;
+    iov.iov_len = sizeof(reply);
+
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    char control[CMSG_SPACE(sizeof(int))];
+    if (passfd >= 0)
+    {
+        memset(control, 0, sizeof(control));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &passfd, sizeof(int));
+    }
+
+    ssize_t n;
+    do
+    {
+        n = sendmsg(fd, &msg, SEND_FLAGS);
+    }
+    while (n < 0 && errno == EINTR);
+    if (n <= 0)
+    {
+        return false;
+    }
+    return sendAll(fd, (const char*) &reply + n, sizeof(reply) - n);
+}
+
+/* Creates shared memory which only has a name until it is opened, so nothing
+ * is left behind however the server or client exits. */
+static int createRegion(size_t size, float **region)
+{
+    static atomic <int> counter(0);
+    for (int attempt = 0; attempt < 100; attempt++)
+    {
+        const string name = "/gmxcpp-" + to_string(getpid()) + "-" + to_string(counter++);
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0 && errno == EEXIST)
+        {
+            continue;
+        }
+        if (fd < 0)
+        {
+            break;
+        }
+        shm_unlink(name.c_str());
+        void *p = (ftruncate(fd, size) == 0) ? mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+        if (p == MAP_FAILED)
+        {
+            ::close(fd);
+            break;
+        }
+        *region = (float*) p;
+        return fd;
+    }
+    throw runtime_error("Cannot create shared memory for a reply.");
+}
+
+TrajectoryServer::TrajectoryServer(string socketPath, size_t memoryBudget)
+{
+    this->socketPath = socketPath;
+    this->memoryBudget = memoryBudget;
+    active = 0;
+
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socketPath.empty() || socketPath.size() >= sizeof(addr.sun_path))
+    {
+        throw runtime_error("Cannot use " + socketPath + " as a socket.");
+    }
+    strcpy(addr.sun_path, socketPath.c_str());
+
+    /* A socket nothing answers on is left from a server that is gone. */
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe >= 0 && connect(probe, (sockaddr*) &addr, sizeof(addr)) == 0)
+    {
+        ::close(probe);
+        throw runtime_error("A server is already running on " + socketPath + ".");
+    }
+    if (probe >= 0)
+    {
+        ::close(probe);
+    }
+    unlink(socketPath.c_str());
+
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 || bind(listener, (sockaddr*) &addr, sizeof(addr)) != 0 || listen(listener, SOMAXCONN) != 0)
+    {
+        if (listener >= 0)
+        {
+            ::close(listener);
+        }
+        throw runtime_error("Cannot create socket " + socketPath + ".");
+    }
+    if (pipe(wakeup) != 0)
+    {
+        ::close(listener);
+        unlink(socketPath.c_str());
+        throw runtime_error("Cannot create socket " + socketPath + ".");
+    }
+}
+
+TrajectoryServer::~TrajectoryServer()
+{
+    ::close(listener);
+    unlink(socketPath.c_str());
+    ::close(wakeup[0]);
+    ::close(wakeup[1]);
+}
+
+void TrajectoryServer::Stop()
+{
+    const char c = 0;
+    if (write(wakeup[1], &c, 1) < 0)
+    {
+        /* The pipe is full, so Run() is being woken up already. */
+    }
+    return;
+}
+
+void TrajectoryServer::Run()
+{
+    cout << "Serving trajectories on " << socketPath << "." << endl;
+    while (true)
+    {
+        pollfd fds[2];
+        fds[0].fd = listener;
+        fds[0].events = POLLIN;
+        fds[1].fd = wakeup[0];
+        fds[1].events = POLLIN;
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            throw runtime_error("Cannot wait for clients on " + socketPath + ".");
+        }
+        if (fds[1].revents != 0)
+        {
+            char c;
+            if (read(wakeup[0], &c, 1) < 0)
+            {
+                /* Woken up anyway. */
+            }
+            break;
+        }
+        if ((fds[0].revents & POLLIN) == 0)
+        {
+            continue;
+        }
+
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0)
+        {
+            continue;
+        }
+        lock_guard <mutex> guard(lock);
+        connections.push_back(fd);
+        active++;
+        thread(&TrajectoryServer::serve, this, fd).detach();
+    }
+
+    /* Clients waiting for a reply get one; the connections are closed after. */
+    unique_lock <mutex> guard(lock);
+    for (size_t i = 0; i < connections.size(); i++)
+    {
+        shutdown(connections[i], SHUT_RD);
+    }
+    idle.wait(guard, [this] { return active == 0; });
+    cout << "Stopped serving trajectories on " << socketPath << "." << endl;
+    return;
+}
+
+/*
+ * Only the lock of the trajectory asked for is held while it is read in, so
+ * one asked for by several clients at once is only read in once, and others
+ * can be opened meanwhile. A trajectory that cannot be read in is tried again
+ * the next time it is asked for.
+ */
+shared_ptr <Trajectory> TrajectoryServer::open(const string &xtcfile, const string &ndxfile)
+{
+    shared_ptr <Opened> opened;
+    {
+        lock_guard <mutex> guard(opening);
+        shared_ptr <Opened> &entry = trajectories[make_pair(xtcfile, ndxfile)];
+        if (!entry)
+        {
+            entry = make_shared<Opened>();
+        }
+        opened = entry;
+    }
+
+    lock_guard <mutex> guard(opened->lock);
+    if (!opened->trj)
+    {
+        shared_ptr <Trajectory> trj = ndxfile.empty() ? make_shared<Trajectory>(xtcfile) : make_shared<Trajectory>(xtcfile, ndxfile);
+        trj->SetThrowOnError(true);
+        if (memoryBudget > 0)
+        {
+            trj->SetMemoryBudget(memoryBudget);
+        }
+        trj->read();
+        opened->trj = trj;
+    }
+    return opened->trj;
+}
+
+/*
+ * Requests on a connection are answered one at a time, so the shared memory
+ * of the connection is only written while the client is waiting for a reply.
+ * A request that cannot be answered gets an error message; one that cannot be
+ * understood closes the connection.
+ */
+void TrajectoryServer::serve(int fd)
+{
+    vector <shared_ptr <Trajectory> > opened;
+    float *region = NULL;
+    size_t regionSize = 0;
+
+    while (true)
+    {
+        ServerRequest request;
+        if (!recvAll(fd, &request, sizeof(request)) || request.length < 0 || request.length > MAX_TEXT)
+        {
+            break;
+        }
+        string text(request.length, '\0');
+        if (request.length > 0 && !recvAll(fd, &text[0], request.length))
+        {
+            break;
+        }
+
+        ServerReply reply;
+        memset(&reply, 0, sizeof(reply));
+        reply.handle = request.handle;
+        int passfd = -1;
+        string error;
+        try
+        {
+            if (request.op == ServerRequest::Open)
+            {
+                const size_t split = text.find('\0');
+                opened.push_back(open(text.substr(0, split), (split == string::npos) ? "" : text.substr(split + 1)));
+                reply.handle = opened.size() - 1;
+            }
+            else if (request.handle < 0 || request.handle >= (int) opened.size())
+            {
+                throw runtime_error("No trajectory was opened as " + to_string(request.handle) + ".");
+            }
+            const Trajectory &trj = *opened[reply.handle];
+            reply.natoms = trj.GetNAtoms();
+            reply.nframes = trj.GetNFrames();
+
+            if (request.op == ServerRequest::Info || request.op == ServerRequest::Coordinates)
+            {
+                if (request.frame < 0 || request.frame >= reply.nframes)
+                {
+                    throw runtime_error("Frame " + to_string(request.frame) + " is not in " + trj.GetFilename() + ".");
+                }
+                reply.step = trj.GetStep(request.frame);
+                reply.time = trj.GetTime(request.frame);
+                triclinicbox box = trj.GetBox(request.frame);
+                for (int i = 0; i < DIM; i++)
+                {
+                    for (int j = 0; j < DIM; j++)
+                    {
+                        reply.box[i][j] = box(i, j);
+                    }
+                }
+            }
+
+            if (request.op == ServerRequest::GroupSize)
+            {
+                reply.count = text.empty() ? trj.GetNAtoms() : trj.GetNAtoms(text);
+            }
+            else if (request.op == ServerRequest::Coordinates)
+            {
+                vector <coordinates> x = text.empty() ? trj.GetXYZ(request.frame) : trj.GetXYZ(request.frame, text);
+                const size_t size = max((size_t) 1, x.size()) * DIM * sizeof(float);
+                if (size > regionSize)
+                {
+                    const size_t newSize = max(size, 2 * regionSize);
+                    float *newRegion;
+                    passfd = createRegion(newSize, &newRegion);
+                    if (region != NULL)
+                    {
+                        munmap(region, regionSize);
+                    }
+                    region = newRegion;
+                    regionSize = newSize;
+                }
+                for (size_t i = 0; i < x.size(); i++)
+                {
+                    region[DIM * i + X] = x[i][X];
+                    region[DIM * i + Y] = x[i][Y];
+                    region[DIM * i + Z] = x[i][Z];
+                }
+                reply.count = x.size();
+            }
+            else if (request.op != ServerRequest::Open && request.op != ServerRequest::Info)
+            {
+                throw runtime_error("Unknown request " + to_string(request.op) + ".");
+            }
+        }
+        catch (runtime_error &excpt)
+        {
+            reply.status = -1;
+            error = excpt.what();
+            reply.length = error.size();
+        }
+
+        const bool sent = sendReply(fd, reply, passfd) && sendAll(fd, error.data(), error.size());
+        if (passfd >= 0)
+        {
+            ::close(passfd);
+        }
+        if (!sent)
+        {
+            break;
+        }
+    }
+
+    if (region != NULL)
+    {
+        munmap(region, regionSize);
+    }
+
+    lock_guard <mutex> guard(lock);
+    connections.erase(find(connections.begin(), connections.end(), fd));
+    ::close(fd);
+    active--;
+    idle.notify_all();
+    return;
+}
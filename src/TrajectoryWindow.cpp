@@ -0,0 +1,233 @@
+/*
+ * libgmxcpp
+ * Copyright (C) 2015 James W. Barnett <jbarnet4@tulane.edu>
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The full license is located in a text file titled "LICENSE" in the root
+ * directory of the source.
+ *
+ */
+
+
+/**
+ * @file
+ * @brief TrajectoryWindow class
+ * @see TrajectoryWindow.h
+ */
+
+#include "gmxcpp/TrajectoryWindow.h"
+#include <stdexcept>
+
+TrajectoryWindow::TrajectoryWindow(string xtcfile, int natoms, const vector <int> &atoms,
+                                   const FrameIndex *frameIndex, int length, int b)
+{
+    if (length < 1)
+    {
+        throw runtime_error("A window must keep at least 1 frame.");
+    }
+    if (b < 0)
+    {
+        throw runtime_error("First frame of a window cannot be negative.");
+    }
+    this->natoms = natoms;
+    this->atoms = atoms;
+    this->length = length;
+    first = b;
+    last = b - 1;
+    position = 0;
+    frames.resize(length);
+    storage.resize(length);
+
+    xd = xdrfile_open(xtcfile.c_str(), "rm");
+    if (xd == NULL)
+    {
+        throw runtime_error("Cannot open " + xtcfile + ".");
+    }
+
+    /* Go to frame b with the frame index, or by skipping the frames before
+     * it (e.g. past the end of an index built before the file grew). */
+    if (frameIndex != NULL && b < frameIndex->GetNFrames())
+    {
+        if (xdrfile_seek(xd, frameIndex->GetOffset(b), SEEK_SET) == 0)
+        {
+            position = b;
+        }
+    }
+    int step;
+    float time;
+    matrix box;
+    while (position < b && skip_xtc(xd, natoms, &step, &time, box) == exdrOK)
+    {
+        ++position;
+    }
+}
+
+TrajectoryWindow::TrajectoryWindow(TrajectoryWindow &&other) noexcept
+{
+    xd = other.xd;
+    natoms = other.natoms;
+    atoms = move(other.atoms);
+    length = other.length;
+    first = other.first;
+    last = other.last;
+    position = other.position;
+    frames = move(other.frames);
+    storage = move(other.storage);
+    spare = move(other.spare);
+    scratch = move(other.scratch);
+    other.xd = NULL;
+}
+
+TrajectoryWindow::~TrajectoryWindow()
+{
+    if (xd != NULL)
+    {
+        xdrfile_close(xd);
+    }
+}
+
+/*
+ * The frame is decoded into a spare buffer, which only replaces the storage of
+ * the oldest frame once the read has succeeded, so a failed read at the end of
+ * the file leaves the window as it was. The storage replaced is the spare
+ * buffer of the next call, unless a copy of its Frame is still held, in which
+ * case new storage is made.
+ */
+bool TrajectoryWindow::Advance()
+{
+    if (xd == NULL || position != last + 1)
+    {
+        return false;
+    }
+
+    const int nsaved = atoms.empty() ? natoms : atoms.size();
+    if (!spare || spare.use_count() > 1)
+    {
+        spare = shared_ptr <float> (new float[nsaved * DIM], default_delete<float[]>());
+    }
+    if (!atoms.empty())
+    {
+        scratch.resize(natoms * DIM);
+    }
+    rvec *x = (rvec*) (atoms.empty() ? spare.get() : scratch.data());
+
+    int step;
+    float time;
+    float prec;
+    matrix box;
+    if (read_xtc(xd, natoms, &step, &time, box, x, &prec) != exdrOK)
+    {
+        return false;
+    }
+
+    rvec *saved = (rvec*) spare.get();
+    for (size_t i = 0; i < atoms.size(); i++)
+    {
+        saved[i][X] = x[atoms[i]][X];
+        saved[i][Y] = x[atoms[i]][Y];
+        saved[i][Z] = x[atoms[i]][Z];
+    }
+    const int slot = (last + 1) % length;
+    frames[slot] = Frame(step, time, box, spare, nsaved);
+    storage[slot].swap(spare);
+
+    ++position;
+    ++last;
+    if (last - first + 1 > length)
+    {
+        ++first;
+    }
+    return true;
+}
+
+int TrajectoryWindow::Advance(int n)
+{
+    int nread = 0;
+    while (nread < n && Advance())
+    {
+        ++nread;
+    }
+    return nread;
+}
+
+int TrajectoryWindow::GetFirst() const
+{
+    return first;
+}
+
+int TrajectoryWindow::GetLast() const
+{
+    return last;
+}
+
+int TrajectoryWindow::GetLength() const
+{
+    return length;
+}
+
+bool TrajectoryWindow::Contains(int frame) const
+{
+    return frame >= first && frame <= last;
+}
+
+const Frame& TrajectoryWindow::at(int frame) const
+{
+    if (!Contains(frame))
+    {
+        throw runtime_error("Frame " + to_string(frame) + " is not in the window (frames " +
+                            to_string(first) + " to " + to_string(last) + ").");
+    }
+    return frames[frame % length];
+}
+
+const Frame& TrajectoryWindow::GetFrame(int frame) const
+{
+    return at(frame);
+}
+
+coordinates TrajectoryWindow::GetXYZ(int frame, int atom) const
+{
+    return at(frame).GetXYZ(atom);
+}
+
+#ifdef AVX
+
+coordinates8 TrajectoryWindow::GetXYZ8F(int frame, int atom) const
+{
+    return coordinates8(at(frame).GetXYZ(atom),
+                        at(frame+1).GetXYZ(atom),
+                        at(frame+2).GetXYZ(atom),
+                        at(frame+3).GetXYZ(atom),
+                        at(frame+4).GetXYZ(atom),
+                        at(frame+5).GetXYZ(atom),
+                        at(frame+6).GetXYZ(atom),
+                        at(frame+7).GetXYZ(atom));
+}
+#endif
+
+triclinicbox TrajectoryWindow::GetBox(int frame) const
+{
+    return at(frame).GetBox();
+}
+
+int TrajectoryWindow::GetStep(int frame) const
+{
+    return at(frame).GetStep();
+}
+
+float TrajectoryWindow::GetTime(int frame) const
+{
+    return at(frame).GetTime();
+}
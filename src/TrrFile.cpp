@@ -0,0 +1,351 @@
+/*
+ * libgmxcpp
+ * Copyright (C) 2015 James W. Barnett <jbarnet4@tulane.edu>
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The full license is located in a text file titled "LICENSE" in the root
+ * directory of the source.
+ *
+ */
+
+/**
+ * @file
+ * @brief TrrFile class
+ * @see TrrFile.h
+ */
+
+#include "gmxcpp/TrrFile.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Every trr frame starts with this number and version string. */
+static const int TRR_MAGIC = 1993;
+static const char TRR_VERSION[] = "GMX_trn_file";
+
+/* XDR stores everything big-endian, 4 byte aligned. */
+static inline uint32_t load32(const unsigned char *p)
+{
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | (uint32_t) p[3];
+}
+
+static inline int loadint(const unsigned char *p)
+{
+    return (int) load32(p);
+}
+
+static inline float loadfloat(const unsigned char *p)
+{
+    uint32_t u = load32(p);
+    float v;
+    memcpy(&v, &u, sizeof(v));
+    return v;
+}
+
+static inline double loaddouble(const unsigned char *p)
+{
+    uint64_t u = ((uint64_t) load32(p) << 32) | load32(p + 4);
+    double v;
+    memcpy(&v, &u, sizeof(v));
+    return v;
+}
+
+TrrFile::TrrFile(string trrfile)
+{
+    this->trrfile = trrfile;
+    natoms = 0;
+    data = NULL;
+    size = 0;
+
+    int fd = open(trrfile.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw runtime_error("Cannot open " + trrfile + ".");
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        throw runtime_error("Cannot open " + trrfile + ".");
+    }
+    size = st.st_size;
+
+    void *p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+    {
+        throw runtime_error("Cannot map " + trrfile + ".");
+    }
+    data = (const unsigned char*) p;
+
+    int64_t offset = 0;
+    while (offset >= 0 && offset < size)
+    {
+        offset = scan(offset);
+    }
+
+    if (frames.empty())
+    {
+        munmap((void*) data, size);
+        throw runtime_error(trrfile + " has no complete trr frames.");
+    }
+}
+
+TrrFile::~TrrFile()
+{
+    if (data != NULL)
+    {
+        munmap((void*) data, size);
+    }
+}
+
+/*
+ * The header is the magic number, the version string, the size in bytes of
+ * each part of the frame, the number of atoms, the step and the number of
+ * energies, followed by the time and lambda in the precision of the file. The
+ * parts follow in the order box, virial, pressure, positions, velocities,
+ * forces; the others are never written by Gromacs.
+ */
+int64_t TrrFile::scan(int64_t offset)
+{
+    const int64_t intsHeader = 3 * 4 + sizeof(TRR_VERSION) - 1 + 13 * 4;
+    if (offset + intsHeader > size)
+    {
+        return -1;
+    }
+
+    const unsigned char *p = data + offset;
+    if (loadint(p) != TRR_MAGIC || loadint(p + 8) != (int) sizeof(TRR_VERSION) - 1 ||
+        memcmp(p + 12, TRR_VERSION, sizeof(TRR_VERSION) - 1) != 0)
+    {
+        if (frames.empty())
+        {
+            throw runtime_error(trrfile + " is not a trr file.");
+        }
+        return -1;
+    }
+    p += 12 + sizeof(TRR_VERSION) - 1;
+
+    int sizes[10];
+    for (int i = 0; i < 10; i++)
+    {
+        sizes[i] = loadint(p + 4 * i);
+    }
+    const int ir = sizes[0], e = sizes[1], box = sizes[2], vir = sizes[3], pres = sizes[4];
+    const int top = sizes[5], sym = sizes[6], x = sizes[7], v = sizes[8], f = sizes[9];
+    const int n = loadint(p + 40);
+    const int step = loadint(p + 44);
+
+    if (ir != 0 || e != 0 || top != 0 || sym != 0 || n <= 0 || (natoms > 0 && n != natoms))
+    {
+        if (frames.empty())
+        {
+            throw runtime_error(trrfile + " has a trr frame that cannot be read.");
+        }
+        return -1;
+    }
+
+    /* The precision is only known from the size of the parts. */
+    int real = 0;
+    if (box != 0)
+    {
+        real = box / (DIM * DIM);
+    }
+    else if (x != 0)
+    {
+        real = x / (n * DIM);
+    }
+    else if (v != 0)
+    {
+        real = v / (n * DIM);
+    }
+    else if (f != 0)
+    {
+        real = f / (n * DIM);
+    }
+    if (real != sizeof(float) && real != sizeof(double))
+    {
+        real = sizeof(float);
+    }
+
+    TrrFrame frame;
+    frame.step = step;
+    frame.dbl = (real == sizeof(double));
+    p += 13 * 4;
+    frame.time = frame.dbl ? loaddouble(p) : loadfloat(p);
+    frame.lambda = frame.dbl ? loaddouble(p + real) : loadfloat(p + real);
+
+    int64_t at = offset + intsHeader + 2 * real;
+    frame.box = (box != 0) ? at : -1;
+    at += (int64_t) box + vir + pres;
+    frame.x = (x != 0) ? at : -1;
+    at += x;
+    frame.v = (v != 0) ? at : -1;
+    at += v;
+    frame.f = (f != 0) ? at : -1;
+    at += f;
+
+    if (at > size)
+    {
+        return -1;
+    }
+
+    natoms = n;
+    frames.push_back(frame);
+    return at;
+}
+
+const TrrFile::TrrFrame& TrrFile::frame(int frame) const
+{
+    if (frame < 0 || frame >= (int) frames.size())
+    {
+        throw runtime_error("Frame " + to_string(frame) + " is not in " + trrfile + ".");
+    }
+    return frames[frame];
+}
+
+coordinates TrrFile::get(int64_t offset, bool dbl, int atom) const
+{
+    if (atom < 0 || atom >= natoms)
+    {
+        throw runtime_error("Atom " + to_string(atom) + " is not in " + trrfile + ".");
+    }
+    if (dbl)
+    {
+        const unsigned char *p = data + offset + (int64_t) atom * DIM * sizeof(double);
+        return coordinates(loaddouble(p), loaddouble(p + 8), loaddouble(p + 16));
+    }
+    const unsigned char *p = data + offset + (int64_t) atom * DIM * sizeof(float);
+    return coordinates(loadfloat(p), loadfloat(p + 4), loadfloat(p + 8));
+}
+
+int TrrFile::GetNFrames() const
+{
+    return frames.size();
+}
+
+int TrrFile::GetNAtoms() const
+{
+    return natoms;
+}
+
+int TrrFile::GetStep(int frame) const
+{
+    return this->frame(frame).step;
+}
+
+float TrrFile::GetTime(int frame) const
+{
+    return this->frame(frame).time;
+}
+
+float TrrFile::GetLambda(int frame) const
+{
+    return this->frame(frame).lambda;
+}
+
+void TrrFile::GetBox(int frame, matrix box) const
+{
+    const TrrFrame &fr = this->frame(frame);
+    for (int i = 0; i < DIM; i++)
+    {
+        for (int j = 0; j < DIM; j++)
+        {
+            if (fr.box == -1)
+            {
+                box[i][j] = 0.0;
+            }
+            else if (fr.dbl)
+            {
+                box[i][j] = loaddouble(data + fr.box + (i * DIM + j) * sizeof(double));
+            }
+            else
+            {
+                box[i][j] = loadfloat(data + fr.box + (i * DIM + j) * sizeof(float));
+            }
+        }
+    }
+    return;
+}
+
+bool TrrFile::HasPositions(int frame) const
+{
+    return this->frame(frame).x != -1;
+}
+
+bool TrrFile::HasVelocities(int frame) const
+{
+    return this->frame(frame).v != -1;
+}
+
+bool TrrFile::HasForces(int frame) const
+{
+    return this->frame(frame).f != -1;
+}
+
+coordinates TrrFile::GetPosition(int frame, int atom) const
+{
+    const TrrFrame &fr = this->frame(frame);
+    if (fr.x == -1)
+    {
+        throw runtime_error("Frame " + to_string(frame) + " of " + trrfile + " has no positions.");
+    }
+    return get(fr.x, fr.dbl, atom);
+}
+
+coordinates TrrFile::GetVelocity(int frame, int atom) const
+{
+    const TrrFrame &fr = this->frame(frame);
+    if (fr.v == -1)
+    {
+        throw runtime_error("Frame " + to_string(frame) + " of " + trrfile + " has no velocities.");
+    }
+    return get(fr.v, fr.dbl, atom);
+}
+
+coordinates TrrFile::GetForce(int frame, int atom) const
+{
+    const TrrFrame &fr = this->frame(frame);
+    if (fr.f == -1)
+    {
+        throw runtime_error("Frame " + to_string(frame) + " of " + trrfile + " has no forces.");
+    }
+    return get(fr.f, fr.dbl, atom);
+}
+
+void TrrFile::GetPositions(int frame, const vector <int> &atoms, rvec *dest) const
+{
+    const TrrFrame &fr = this->frame(frame);
+    if (fr.x == -1)
+    {
+        throw runtime_error("Frame " + to_string(frame) + " of " + trrfile + " has no positions.");
+    }
+
+    const int n = atoms.empty() ? natoms : atoms.size();
+    const int64_t real = fr.dbl ? sizeof(double) : sizeof(float);
+    for (int i = 0; i < n; i++)
+    {
+        const int atom = atoms.empty() ? i : atoms[i];
+        const unsigned char *p = data + fr.x + (int64_t) atom * DIM * real;
+        for (int d = 0; d < DIM; d++)
+        {
+            dest[i][d] = fr.dbl ? loaddouble(p + d * real) : loadfloat(p + d * real);
+        }
+    }
+    return;
+}
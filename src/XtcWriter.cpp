@@ -0,0 +1,245 @@
+/*
+ * libgmxcpp
+ * Copyright (C) 2015 James W. Barnett <jbarnet4@tulane.edu>
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The full license is located in a text file titled "LICENSE" in the root
+ * directory of the source.
+ *
+ */
+
+
+/**
+ * @file
+ * @brief XtcWriter class
+ * @see XtcWriter.h
+ */
+
+#include "gmxcpp/XtcWriter.h"
+#include "xdrfile_xtc.h"
+#include <cstdlib>
+#include <iostream>
+
+XtcWriter::XtcWriter(string xtcfile, int nthreads, float prec)
+{
+    if (nthreads < 1)
+    {
+        throw runtime_error("Number of threads must be at least 1.");
+    }
+    this->xtcfile = xtcfile;
+    this->prec = prec;
+    natoms = -1;
+    maxPending = 4 * nthreads;
+    next = 0;
+    submitted = 0;
+    written = 0;
+    closing = false;
+    failed = false;
+
+    fp = fopen(xtcfile.c_str(), "wb");
+    if (fp == NULL)
+    {
+        throw runtime_error("Cannot write " + xtcfile + ".");
+    }
+
+    for (int i = 0; i < nthreads; i++)
+    {
+        compressors.push_back(thread(&XtcWriter::compress, this));
+    }
+    writer = thread(&XtcWriter::write, this);
+}
+
+XtcWriter::~XtcWriter()
+{
+    try
+    {
+        Close();
+    }
+    catch (runtime_error &excpt)
+    {
+        cerr << excpt.what() << endl;
+    }
+}
+
+/*
+ * Each frame is compressed with write_xtc into its own buffer in memory, so
+ * the threads share nothing but the queue. Compressing is done without
+ * holding the lock.
+ */
+void XtcWriter::compress()
+{
+    while (true)
+    {
+        Job *job;
+        {
+            unique_lock <mutex> guard(lock);
+            changed.wait(guard, [this] { return closing || next < submitted; });
+            if (next == submitted)
+            {
+                return;
+            }
+            job = &jobs[next];
+            ++next;
+        }
+
+        job->data = NULL;
+        job->size = 0;
+        XDRFILE *xd = xdrfile_open_memstream(&job->data, &job->size);
+        bool ok = (xd != NULL) &&
+                  (write_xtc(xd, natoms, job->step, job->time, job->box, (rvec*) job->x.data(), prec) == exdrOK);
+        if (xd != NULL)
+        {
+            ok = (xdrfile_close(xd) == 0) && ok;
+        }
+        vector <float>().swap(job->x);
+
+        lock_guard <mutex> guard(lock);
+        job->compressed = true;
+        job->ok = ok;
+        changed.notify_all();
+    }
+}
+
+/*
+ * Frames are written as soon as they and every frame before them are
+ * compressed. After a failure the rest are still taken off the queue, but
+ * not written, so Write() and Close() do not wait forever.
+ */
+void XtcWriter::write()
+{
+    while (true)
+    {
+        Job job;
+        {
+            unique_lock <mutex> guard(lock);
+            changed.wait(guard, [this] {
+                return (written < submitted && jobs.at(written).compressed) || (closing && written == submitted);
+            });
+            if (written == submitted)
+            {
+                return;
+            }
+            job = move(jobs.at(written));
+            jobs.erase(written);
+        }
+
+        bool ok = job.ok && !failed && fwrite(job.data, 1, job.size, fp) == job.size;
+        free(job.data);
+
+        lock_guard <mutex> guard(lock);
+        failed = failed || !ok;
+        ++written;
+        changed.notify_all();
+    }
+}
+
+void XtcWriter::Write(int step, float time, triclinicbox box, const vector <coordinates> &x)
+{
+    if (fp == NULL)
+    {
+        throw runtime_error(xtcfile + " is already closed.");
+    }
+    if (natoms == -1)
+    {
+        natoms = x.size();
+    }
+    if ((int) x.size() != natoms)
+    {
+        throw runtime_error("Every frame written to " + xtcfile + " must have " + to_string(natoms) + " atoms.");
+    }
+
+    /* The copy is made before waiting for room in the queue. */
+    Job job;
+    job.step = step;
+    job.time = time;
+    for (int i = 0; i < DIM; i++)
+    {
+        for (int j = 0; j < DIM; j++)
+        {
+            job.box[i][j] = box(i, j);
+        }
+    }
+    job.x.resize(natoms * DIM);
+    for (int i = 0; i < natoms; i++)
+    {
+        job.x[i * DIM + X] = x[i][X];
+        job.x[i * DIM + Y] = x[i][Y];
+        job.x[i * DIM + Z] = x[i][Z];
+    }
+    job.data = NULL;
+    job.size = 0;
+    job.compressed = false;
+    job.ok = false;
+
+    unique_lock <mutex> guard(lock);
+    changed.wait(guard, [this] { return failed || submitted - written < (long) maxPending; });
+    if (failed)
+    {
+        throw runtime_error("Cannot write " + xtcfile + ".");
+    }
+    jobs[submitted] = move(job);
+    ++submitted;
+    changed.notify_all();
+    return;
+}
+
+void XtcWriter::Write(const Frame &frame)
+{
+    Write(frame.GetStep(), frame.GetTime(), frame.GetBox(), frame.GetXYZ());
+    return;
+}
+
+void XtcWriter::Write(const Trajectory &trj, int frame)
+{
+    Write(trj.GetStep(frame), trj.GetTime(frame), trj.GetBox(frame), trj.GetXYZ(frame));
+    return;
+}
+
+void XtcWriter::Write(const Trajectory &trj, int frame, string groupName)
+{
+    Write(trj.GetStep(frame), trj.GetTime(frame), trj.GetBox(frame), trj.GetXYZ(frame, groupName));
+    return;
+}
+
+void XtcWriter::Close()
+{
+    if (fp == NULL)
+    {
+        return;
+    }
+    {
+        lock_guard <mutex> guard(lock);
+        closing = true;
+        changed.notify_all();
+    }
+    for (size_t i = 0; i < compressors.size(); i++)
+    {
+        compressors[i].join();
+    }
+    writer.join();
+
+    bool ok = (fclose(fp) == 0) && !failed;
+    fp = NULL;
+    if (!ok)
+    {
+        throw runtime_error("Cannot write " + xtcfile + ".");
+    }
+    return;
+}
+
+int XtcWriter::GetNFrames() const
+{
+    return submitted;
+}
@@ -11,6 +11,12 @@
  * of the License, or (at your option) any later version.
  */
 
+/* 64-bit off_t, ftello and fseeko even on 32-bit systems. This only has an
+ * effect if defined before any system header is included. */
+#ifndef _FILE_OFFSET_BITS
+#define _FILE_OFFSET_BITS  64
+#endif
+
 /* Get HAVE_RPC_XDR_H, F77_FUNC from config.h if available */
 #ifdef HAVE_CONFIG_H
 #include <config.h>
@@ -22,8 +28,6 @@
 #include <math.h>
 #include <limits.h>
 
-#define _FILE_OFFSET_BITS  64
-
 /* get fixed-width types if we are using ANSI C99 */
 #ifdef HAVE_STDINT_H
 #  include <stdint.h>
@@ -37,7 +41,18 @@
 #  include <rpc/xdr.h>
 #endif
 
-#include "gmxcpp/xdrfile.h"
+/* Memory-mapped reading needs POSIX mmap and our own XDR routines */
+#if (defined __unix__ || defined __APPLE__) && !defined HAVE_RPC_XDR_H
+#  define XDRFILE_MMAP
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#endif
+
+#ifdef __AVX__
+#  include <immintrin.h>
+#endif
+
+#include "xdrfile.h"
 
 /* Default FORTRAN name mangling is: lower case name, append underscore */
 #ifndef F77_FUNC
@@ -106,9 +121,8 @@ struct XDR {
         int				(*x_putlong) (XDR *__xdrs, int32_t *__lp);
         int				(*x_getbytes) (XDR *__xdrs, char *__addr, unsigned int __len);
         int				(*x_putbytes) (XDR *__xdrs, char *__addr, unsigned int __len);
-        /* two next routines are not 64-bit IO safe - don't use! */
-        unsigned int	(*x_getpostn) (XDR *__xdrs);
-        int				(*x_setpostn) (XDR *__xdrs, unsigned int __pos);
+        int64_t			(*x_getpostn) (XDR *__xdrs);
+        int				(*x_setpostn) (XDR *__xdrs, int64_t __pos);
         void			(*x_destroy) (XDR *__xdrs);
     }
     *x_ops;
@@ -126,6 +140,9 @@ static int  xdr_double(XDR *xdrs, double *ip);
 static int  xdr_string(XDR *xdrs, char **ip, unsigned int maxsize);
 static int  xdr_opaque(XDR *xdrs, char *cp, unsigned int cnt);
 static void xdrstdio_create(XDR *xdrs, FILE *fp, enum xdr_op xop);
+#ifdef XDRFILE_MMAP
+static void xdrmmap_create(XDR *xdrs, XDRFILE *xfp, enum xdr_op xop);
+#endif
 
 #define xdr_getpos(xdrs)                                \
     (*(xdrs)->x_ops->x_getpostn)(xdrs)
@@ -157,9 +174,39 @@ struct XDRFILE {
     int		buf1size;   /**< Current allocated length of buf1          */
     int *	buf2;       /**< Buffer for internal use                   */
     int		buf2size;   /**< Current allocated length of buf2          */
+    unsigned char *map; /**< File contents if memory-mapped, or NULL    */
+    int64_t	mapsize;    /**< Length of the mapped file in bytes        */
+    int64_t	mappos;     /**< Current position in the mapped file       */
 };
 
 
+#ifdef XDRFILE_MMAP
+/* Maps a file opened for reading into memory. Returns 0 if that is not
+ * possible (e.g. empty file or no address space left), in which case the
+ * file is read with stdio as usual.
+ */
+static int
+xdrfile_map(XDRFILE *xfp)
+{
+    struct stat st;
+    void *map;
+
+    if (fstat(fileno(xfp->fp), &st) != 0 || st.st_size <= 0 ||
+        (uint64_t)st.st_size > (size_t)-1)
+        return 0;
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE,
+               fileno(xfp->fp), 0);
+    if (map == MAP_FAILED)
+        return 0;
+    xfp->map = (unsigned char *)map;
+    xfp->mapsize = st.st_size;
+    xfp->mappos = 0;
+    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+    return 1;
+}
+#endif
+
+
 
 
 /*************************************************************
@@ -200,12 +247,75 @@ xdrfile_open(const char *path, const char *mode)
         return NULL;
     }
     xfp->mode = *mode;
+    xfp->map = NULL;
+    xfp->mapsize = xfp->mappos = 0;
+#ifdef XDRFILE_MMAP
+    if (xdrmode == XDR_DECODE && strchr(mode, 'm') != NULL && xdrfile_map(xfp))
+        xdrmmap_create((XDR *)(xfp->xdr), xfp, xdrmode);
+    else
+#endif
     xdrstdio_create((XDR *)(xfp->xdr), xfp->fp, xdrmode);
     xfp->buf1 = xfp->buf2 = NULL;
     xfp->buf1size = xfp->buf2size = 0;
     return xfp;
 }
 
+XDRFILE *
+xdrfile_open_memory(const void *data, int64_t size)
+{
+#ifdef XDRFILE_MMAP
+    XDRFILE *xfp;
+
+    if (data == NULL || size < 0)
+        return NULL;
+    if ((xfp = (XDRFILE *)calloc(1, sizeof(XDRFILE))) == NULL)
+        return NULL;
+    if ((xfp->xdr = (XDR *)malloc(sizeof(XDR))) == NULL) {
+        free(xfp);
+        return NULL;
+    }
+    /* Read exactly like a mapped file, but there is no file (fp is NULL)
+     * and the memory belongs to the caller. */
+    xfp->mode = 'r';
+    xfp->map = (unsigned char *)data;
+    xfp->mapsize = size;
+    xfp->mappos = 0;
+    xdrmmap_create((XDR *)(xfp->xdr), xfp, XDR_DECODE);
+    return xfp;
+#else
+    return NULL;
+#endif
+}
+
+XDRFILE *
+xdrfile_open_memstream(char **data, size_t *size)
+{
+#ifdef XDRFILE_MMAP
+    XDRFILE *xfp;
+
+    if (data == NULL || size == NULL)
+        return NULL;
+    if ((xfp = (XDRFILE *)calloc(1, sizeof(XDRFILE))) == NULL)
+        return NULL;
+    /* A stdio stream backed by memory, so it is written like any file and
+     * xdrfile_close() finishes the buffer when it closes the stream. */
+    if ((xfp->fp = open_memstream(data, size)) == NULL) {
+        free(xfp);
+        return NULL;
+    }
+    if ((xfp->xdr = (XDR *)malloc(sizeof(XDR))) == NULL) {
+        fclose(xfp->fp);
+        free(xfp);
+        return NULL;
+    }
+    xfp->mode = 'w';
+    xdrstdio_create((XDR *)(xfp->xdr), xfp->fp, XDR_ENCODE);
+    return xfp;
+#else
+    return NULL;
+#endif
+}
+
 int
 xdrfile_close(XDRFILE *xfp)
 {
@@ -216,8 +326,12 @@ xdrfile_close(XDRFILE *xfp)
         if (xfp->xdr)
             xdr_destroy((XDR *)(xfp->xdr));
         free(xfp->xdr);
-        /* close the file */
-        ret = fclose(xfp->fp);
+#ifdef XDRFILE_MMAP
+        if (xfp->map && xfp->fp)
+            munmap(xfp->map, (size_t)xfp->mapsize);
+#endif
+        /* close the file, unless reading from memory */
+        ret = xfp->fp ? fclose(xfp->fp) : 0;
         if (xfp->buf1size)
             free(xfp->buf1);
         if (xfp->buf2size)
@@ -228,6 +342,49 @@ xdrfile_close(XDRFILE *xfp)
 }
 
 
+int64_t
+xdrfile_tell(XDRFILE *xfp)
+{
+    if (xfp == NULL)
+        return -1;
+    if (xfp->map)
+        return xfp->mappos;
+    return (int64_t)ftello(xfp->fp);
+}
+
+int
+xdrfile_seek(XDRFILE *xfp, int64_t pos, int whence)
+{
+    if (xfp == NULL)
+        return -1;
+    if (xfp->map) {
+        if (whence == SEEK_CUR)
+            pos += xfp->mappos;
+        else if (whence == SEEK_END)
+            pos += xfp->mapsize;
+        if (pos < 0 || pos > xfp->mapsize)
+            return -1;
+        xfp->mappos = pos;
+        return 0;
+    }
+    return fseeko(xfp->fp, (off_t)pos, whence);
+}
+
+int
+xdrfile_advise(XDRFILE *xfp, int advice)
+{
+    if (xfp == NULL)
+        return -1;
+#ifdef XDRFILE_MMAP
+    if (xfp->map && xfp->fp)
+        return madvise(xfp->map, (size_t)xfp->mapsize,
+                       advice == xdrRANDOM ? MADV_RANDOM :
+                       advice == xdrSEQUENTIAL ? MADV_SEQUENTIAL : MADV_NORMAL);
+#endif
+    return 0;
+}
+
+
 
 int
 xdrfile_read_int(int *ptr, int ndata, XDRFILE *xfp)
@@ -623,45 +780,114 @@ encodeints(int buf[], int num_of_ints, int num_of_bits,
 }
 
 
+/*
+ * State of the compressed data being decoded by decodebits/decodeints.
+ * The data is read into a 64-bit buffer holding the next unread bits,
+ * starting at its top bit, so that most fields are extracted with a single
+ * shift. next points either into the data read into buf2, or straight into
+ * a memory-mapped file so that nothing is copied.
+ */
+struct bitstream {
+    const unsigned char *next;  /* next byte to load into buf         */
+    const unsigned char *end;   /* end of the compressed data         */
+    uint64_t buf;               /* unread bits, from the top bit down */
+    int nbits;                  /* number of unread bits in buf       */
+};
+
+static void
+bitstream_init(struct bitstream *bs, const unsigned char *cbuf, int nbytes)
+{
+    bs->next = cbuf;
+    bs->end = cbuf + nbytes;
+    bs->buf = 0;
+    bs->nbits = 0;
+}
+
+/*
+ * refill - load as many whole bytes into the bit buffer as fit
+ *
+ * While at least 8 bytes are left this is a single unaligned load. The bits
+ * loaded below the last whole byte are the ones that follow in the data, so
+ * loading them again next time does not change them. Near the end of the
+ * data bytes are loaded one at a time, so we never read past it (which may
+ * be past the end of a memory-mapped file).
+ */
+static inline void
+refill(struct bitstream *bs)
+{
+    uint64_t v;
+
+    if (bs->end - bs->next >= 8) {
+        memcpy(&v, bs->next, sizeof(v));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#else
+        v = __builtin_bswap64(v);
+#endif
+        bs->buf |= v >> bs->nbits;
+        bs->next += (63 - bs->nbits) >> 3;
+        bs->nbits |= 56;
+    } else {
+        while (bs->nbits <= 56 && bs->next < bs->end) {
+            bs->buf |= (uint64_t)*bs->next++ << (56 - bs->nbits);
+            bs->nbits += 8;
+        }
+    }
+}
+
 /*
  * decodebits - decode number from buf using specified number of bits
  *
- * extract the number of bits from the array buf and construct an integer
- * from it. Return that value.
+ * extract the number of bits (at most 32) from the bit stream and construct
+ * an integer from it. Return that value.
  *
  */
-static int
-decodebits(int buf[], int num_of_bits)
+static inline int
+decodebits(struct bitstream *bs, int num_of_bits)
 {
-    int cnt, num;
-    unsigned int lastbits, lastbyte;
-    unsigned char *cbuf;
-    int mask = (1 << num_of_bits) - 1;
-
-    cbuf = ((unsigned char *)buf) + 3 * sizeof(*buf);
-    cnt = buf[0];
-    lastbits = (unsigned int)buf[1];
-    lastbyte = (unsigned int)buf[2];
+    unsigned int num;
 
-    num = 0;
-    while (num_of_bits >= 8) {
-        lastbyte = (lastbyte << 8) | cbuf[cnt++];
-        num |= (lastbyte >> lastbits) << (num_of_bits - 8);
-        num_of_bits -= 8;
-    }
-    if (num_of_bits > 0) {
-        if (lastbits < num_of_bits) {
-            lastbits += 8;
-            lastbyte = (lastbyte << 8) | cbuf[cnt++];
-        }
-        lastbits -= num_of_bits;
-        num |= (lastbyte >> lastbits) & ((1 << num_of_bits) - 1);
+    if (num_of_bits == 0)
+        return 0;
+    if (bs->nbits < num_of_bits) {
+        refill(bs);
+        /* corrupt data: pretend it continues with zeros */
+        if (bs->nbits < num_of_bits)
+            bs->nbits = num_of_bits;
     }
-    num &= mask;
-    buf[0] = cnt;
-    buf[1] = lastbits;
-    buf[2] = lastbyte;
-    return num;
+    num = (unsigned int)(bs->buf >> (64 - num_of_bits));
+    bs->buf <<= num_of_bits;
+    bs->nbits -= num_of_bits;
+    return (int)num;
+}
+
+/*
+ * reciprocal - precompute the reciprocal of a divisor for fastdiv()
+ *
+ * For 32-bit n and d, n / d is the top 64 bits of the 128-bit product of n
+ * and 2^64 / d + 1 (rounded down), so the division becomes a multiplication
+ * (Lemire, Kaser and Kurz, "Faster remainder by direct computation", 2019).
+ * The reciprocal of 1 does not fit in 64 bits and is returned as 0.
+ *
+ */
+static inline uint64_t
+reciprocal(unsigned int d)
+{
+    return (d > 1) ? UINT64_MAX / d + 1 : 0;
+}
+
+/*
+ * fastdiv - n / d, given the reciprocal m of d from reciprocal()
+ */
+static inline unsigned int
+fastdiv(unsigned int n, unsigned int d, uint64_t m)
+{
+#ifdef __SIZEOF_INT128__
+    if (m == 0)
+        return n;
+    return (unsigned int)(((unsigned __int128)m * n) >> 64);
+#else
+    return n / d;
+#endif
 }
 
 /*
@@ -669,30 +895,44 @@ decodebits(int buf[], int num_of_bits)
  *
  * this routine is the inverse from encodeints() and decodes the small integers
  * written to buf by calculating the remainder and doing divisions with
- * the given sizes[]. You need to specify the total number of bits to be
- * used from buf in num_of_bits.
+ * the given sizes[], using their reciprocals in recips[] instead of dividing.
+ * You need to specify the total number of bits to be used from buf in
+ * num_of_bits. The whole bytes of the big number are taken from the bit
+ * stream up to four at a time.
  *
  */
 static void
-decodeints(int buf[], int num_of_ints, int num_of_bits,
-           unsigned int sizes[], int nums[])
+decodeints(struct bitstream *bs, int num_of_ints, int num_of_bits,
+           unsigned int sizes[], const uint64_t recips[], int nums[])
 {
     int bytes[32];
-    int i, j, num_of_bytes, p, num;
+    int i, j, num_of_bytes, shift;
+    unsigned int v, p, num;
 
     bytes[1] = bytes[2] = bytes[3] = 0;
     num_of_bytes = 0;
-    while (num_of_bits > 8) {
-        bytes[num_of_bytes++] = decodebits(buf, 8);
-        num_of_bits -= 8;
+    while (num_of_bits > 32) {
+        /* whole bytes, but always leave the last 1-8 bits for below */
+        v = (unsigned int)decodebits(bs, 32);
+        bytes[num_of_bytes++] = v >> 24;
+        bytes[num_of_bytes++] = (v >> 16) & 0xff;
+        bytes[num_of_bytes++] = (v >> 8) & 0xff;
+        bytes[num_of_bytes++] = v & 0xff;
+        num_of_bits -= 32;
+    }
+    if (num_of_bits > 0) {
+        /* at most 32 bits are left: the remaining whole bytes, then the
+         * last 1-8 bits as one byte */
+        v = (unsigned int)decodebits(bs, num_of_bits);
+        for (shift = num_of_bits - 8; shift > 0; shift -= 8)
+            bytes[num_of_bytes++] = (v >> shift) & 0xff;
+        bytes[num_of_bytes++] = v & ((1u << (shift + 8)) - 1);
     }
-    if (num_of_bits > 0)
-        bytes[num_of_bytes++] = decodebits(buf, num_of_bits);
     for (i = num_of_ints - 1; i > 0; i--) {
         num = 0;
         for (j = num_of_bytes - 1; j >= 0; j--) {
             num = (num << 8) | bytes[j];
-            p = num / sizes[i];
+            p = fastdiv(num, sizes[i], recips[i]);
             bytes[j] = p;
             num = num - p * sizes[i];
         }
@@ -701,6 +941,30 @@ decodeints(int buf[], int num_of_ints, int num_of_bits,
     nums[0] = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (bytes[3] << 24);
 }
 
+/*
+ * getopaque - get the compressed data of cnt bytes that follows in the file
+ *
+ * For memory-mapped files this returns a pointer straight into the map,
+ * otherwise the data is read into buf. Returns NULL on error.
+ */
+static const unsigned char *
+getopaque(XDRFILE *xfp, char *buf, int cnt)
+{
+    const unsigned char *p;
+    int64_t padded = ((int64_t)cnt + 3) & ~(int64_t)3;
+
+    if (xfp->map) {
+        if (cnt <= 0 || xfp->mappos + padded > xfp->mapsize)
+            return NULL;
+        p = xfp->map + xfp->mappos;
+        xfp->mappos += padded;
+        return p;
+    }
+    if (xdrfile_read_opaque(buf, cnt, xfp) == 0)
+        return NULL;
+    return (const unsigned char *)buf;
+}
+
 
 static const int magicints[] =
 {
@@ -713,25 +977,122 @@ static const int magicints[] =
     4194304, 5284491, 6658042, 8388607, 10568983, 13316085, 16777216
 };
 
+/* magicrecip[i] is the reciprocal of magicints[i] for fastdiv(), precomputed
+ * as 2^64 / magicints[i] + 1 (rounded down), or 0 where magicints[i] is 0. */
+static const uint64_t magicrecip[] =
+{
+    0, 0, 0,
+    0, 0, 0,
+    0, 0, 0,
+    UINT64_C(2305843009213693952), UINT64_C(1844674407370955162), UINT64_C(1537228672809129302),
+    UINT64_C(1152921504606846976), UINT64_C(922337203685477581), UINT64_C(737869762948382065),
+    UINT64_C(576460752303423488), UINT64_C(461168601842738791), UINT64_C(368934881474191033),
+    UINT64_C(288230376151711744), UINT64_C(230584300921369396), UINT64_C(182641030432767838),
+    UINT64_C(144115188075855872), UINT64_C(114576050147264296), UINT64_C(90870660461623407),
+    UINT64_C(72057594037927936), UINT64_C(57288025073632148), UINT64_C(45435330230811704),
+    UINT64_C(36028797018963968), UINT64_C(28599603215053569), UINT64_C(22717665115405852),
+    UINT64_C(18014398509481984), UINT64_C(14299801607526785), UINT64_C(11351842506898186),
+    UINT64_C(9007199254740992), UINT64_C(7149900803763393), UINT64_C(5675921253449093),
+    UINT64_C(4503599627370496), UINT64_C(3645601595594774), UINT64_C(2837524084557692),
+    UINT64_C(2251799813685248), UINT64_C(1787302012761317), UINT64_C(1418652931916447),
+    UINT64_C(1125899906842624), UINT64_C(893651006380659), UINT64_C(709299191514191),
+    UINT64_C(562949953421312), UINT64_C(446814680240028), UINT64_C(354642777539356),
+    UINT64_C(281474976710656), UINT64_C(223407340120014), UINT64_C(177319684264398),
+    UINT64_C(140737488355328), UINT64_C(111703670060007), UINT64_C(88659416012024),
+    UINT64_C(70368744177664), UINT64_C(55851835030004), UINT64_C(44329601476736),
+    UINT64_C(35184439197825), UINT64_C(27925875238941), UINT64_C(22164774106145),
+    UINT64_C(17592186044416), UINT64_C(13962937619471), UINT64_C(11082387053073),
+    UINT64_C(8796093022208), UINT64_C(6981466167487), UINT64_C(5541191862025),
+    UINT64_C(4398046511104), UINT64_C(3490732423182), UINT64_C(2770595931013),
+    UINT64_C(2199023517697), UINT64_C(1745366046451), UINT64_C(1385297861475),
+    UINT64_C(1099511627776)
+};
+
+
 #define FIRSTIDX 9
 /* note that magicints[FIRSTIDX-1] == 0 */
 #define LASTIDX (sizeof(magicints) / sizeof(*magicints))
 
+/*
+ * dequantize - convert the decoded integers to coordinates
+ *
+ * Done in one pass after decoding rather than atom by atom, so that the
+ * compiler can vectorize it. Each value is converted and multiplied exactly
+ * as before, so the result is the same.
+ */
+static void
+dequantize(const int *ip, int n, float inv_precision, float *fp)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+        fp[i] = ip[i] * inv_precision;
+}
+
+/*
+ * dequantize_soa - convert the decoded integers to separate x, y and z arrays
+ *
+ * With AVX, 8 atoms (24 interleaved integers) are converted at a time and
+ * transposed with three shuffles into one register each of x, y and z.
+ */
+static void
+dequantize_soa(const int *ip, int natoms, float inv_precision,
+               float *x, float *y, float *z)
+{
+    int i = 0;
+#ifdef __AVX__
+    const __m256 inv = _mm256_set1_ps(inv_precision);
+    __m256 m03, m14, m25, xy, yz;
+
+    for (; i + 8 <= natoms; i += 8, ip += 24) {
+        /* m03 = x0 y0 z0 x1 | x4 y4 z4 x5, and so on */
+        m03 = _mm256_insertf128_ps(_mm256_castps128_ps256(
+                  _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(ip)))),
+                  _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(ip + 12))), 1);
+        m14 = _mm256_insertf128_ps(_mm256_castps128_ps256(
+                  _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(ip + 4)))),
+                  _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(ip + 16))), 1);
+        m25 = _mm256_insertf128_ps(_mm256_castps128_ps256(
+                  _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(ip + 8)))),
+                  _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(ip + 20))), 1);
+        xy = _mm256_shuffle_ps(m14, m25, _MM_SHUFFLE(2, 1, 3, 2));
+        yz = _mm256_shuffle_ps(m03, m14, _MM_SHUFFLE(1, 0, 2, 1));
+        _mm256_storeu_ps(x + i, _mm256_mul_ps(
+                  _mm256_shuffle_ps(m03, xy, _MM_SHUFFLE(2, 0, 3, 0)), inv));
+        _mm256_storeu_ps(y + i, _mm256_mul_ps(
+                  _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0)), inv));
+        _mm256_storeu_ps(z + i, _mm256_mul_ps(
+                  _mm256_shuffle_ps(yz, m25, _MM_SHUFFLE(3, 0, 3, 1)), inv));
+    }
+#endif
+    for (; i < natoms; i++, ip += 3) {
+        x[i] = ip[0] * inv_precision;
+        y[i] = ip[1] * inv_precision;
+        z[i] = ip[2] * inv_precision;
+    }
+}
+
 /* Compressed coordinate routines - modified from the original
  * implementation by Frans v. Hoesel to make them threadsafe.
  */
-int
-xdrfile_decompress_coord_float(float *	ptr,
-                               int *	size,
-                               float *	precision,
-                               XDRFILE *xfp)
+static int
+decompress_coord_float(float *	ptr,
+                       float *	y,
+                       float *	z,
+                       int *	ip,
+                       int *	size,
+                       float *	precision,
+                       XDRFILE *xfp)
 {
     int minint[3], maxint[3], *lip;
     int smallidx, minidx, maxidx;
     unsigned sizeint[3], sizesmall[3], bitsizeint[3], size3;
-    int k, *buf1, *buf2, lsize, flag;
+    int k, *buf1, *buf2, lsize, flag, nbytes;
+    struct bitstream bs;
+    const unsigned char *cbuf;
+    uint64_t recipint[3], recipsmall[3];
     int smallnum, smaller, larger, i, is_smaller, run;
-    float *lfp, inv_precision;
+    float inv_precision, tmpdata[27];
     int tmp, *thiscoord, prevcoord[3];
     unsigned int bitsize;
 
@@ -739,7 +1100,7 @@ xdrfile_decompress_coord_float(float *	ptr,
     bitsizeint[1] = 0;
     bitsizeint[2] = 0;
 
-    if (xfp == NULL || ptr == NULL)
+    if (xfp == NULL || (ptr == NULL && ip == NULL))
         return -1;
     tmp = xdrfile_read_int(&lsize, 1, xfp);
     if (tmp == 0)
@@ -764,9 +1125,21 @@ xdrfile_decompress_coord_float(float *	ptr,
         }
     }
     /* Dont bother with compression for three atoms or less */
-    if (*size <= 9)
-        return xdrfile_read_float(ptr, size3, xfp) / 3;
+    if (*size <= 9) {
+        /* there are no integers to return */
+        if (ip != NULL)
+            return -1;
+        if (y == NULL)
+            return xdrfile_read_float(ptr, size3, xfp) / 3;
         /* return number of coords, not floats */
+        tmp = xdrfile_read_float(tmpdata, size3, xfp) / 3;
+        for (i = 0; i < tmp; i++) {
+            ptr[i] = tmpdata[3 * i];
+            y[i] = tmpdata[3 * i + 1];
+            z[i] = tmpdata[3 * i + 2];
+        }
+        return tmp;
+    }
     /* Compression-time if we got here. Read precision first */
     xdrfile_read_float(precision, 1, xfp);
 
@@ -790,6 +1163,9 @@ xdrfile_decompress_coord_float(float *	ptr,
         bitsize = 0; /* flag the use of large sizes */
     } else {
         bitsize = sizeofints(3, sizeint);
+        recipint[0] = reciprocal(sizeint[0]);
+        recipint[1] = reciprocal(sizeint[1]);
+        recipint[2] = reciprocal(sizeint[2]);
     }
 
     if (xdrfile_read_int(&smallidx, 1, xfp) == 0)
@@ -802,17 +1178,17 @@ xdrfile_decompress_coord_float(float *	ptr,
     smaller = magicints[tmp] / 2;
     smallnum = magicints[smallidx] / 2;
     sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+    recipsmall[0] = recipsmall[1] = recipsmall[2] = magicrecip[smallidx];
     larger = magicints[maxidx];
 
-    /* buf2[0] holds the length in bytes */
+    /* nbytes holds the length of the compressed data in bytes */
 
-    if (xdrfile_read_int(buf2, 1, xfp) == 0)
+    if (xdrfile_read_int(&nbytes, 1, xfp) == 0)
         return 0;
-    if (xdrfile_read_opaque((char *)&(buf2[3]), (unsigned int)buf2[0], xfp) == 0)
+    if ((cbuf = getopaque(xfp, (char *)&(buf2[3]), nbytes)) == NULL)
         return 0;
-    buf2[0] = buf2[1] = buf2[2] = 0;
+    bitstream_init(&bs, cbuf, nbytes);
 
-    lfp = ptr;
     inv_precision = 1.0 / *precision;
     run = 0;
     i = 0;
@@ -821,11 +1197,11 @@ xdrfile_decompress_coord_float(float *	ptr,
         thiscoord = (int *)(lip) + i * 3;
 
         if (bitsize == 0) {
-            thiscoord[0] = decodebits(buf2, bitsizeint[0]);
-            thiscoord[1] = decodebits(buf2, bitsizeint[1]);
-            thiscoord[2] = decodebits(buf2, bitsizeint[2]);
+            thiscoord[0] = decodebits(&bs, bitsizeint[0]);
+            thiscoord[1] = decodebits(&bs, bitsizeint[1]);
+            thiscoord[2] = decodebits(&bs, bitsizeint[2]);
         } else {
-            decodeints(buf2, 3, bitsize, sizeint, thiscoord);
+            decodeints(&bs, 3, bitsize, sizeint, recipint, thiscoord);
         }
 
         i++;
@@ -837,18 +1213,21 @@ xdrfile_decompress_coord_float(float *	ptr,
         prevcoord[1] = thiscoord[1];
         prevcoord[2] = thiscoord[2];
 
-        flag = decodebits(buf2, 1);
+        flag = decodebits(&bs, 1);
         is_smaller = 0;
         if (flag == 1) {
-            run = decodebits(buf2, 5);
+            run = decodebits(&bs, 5);
             is_smaller = run % 3;
             run -= is_smaller;
             is_smaller--;
         }
         if (run > 0) {
-            thiscoord += 3;
             for (k = 0; k < run; k += 3) {
-                decodeints(buf2, 3, smallidx, sizesmall, thiscoord);
+                /* each atom of the run gets its own place in buf1 */
+                if (i >= lsize)
+                    return -1;
+                thiscoord = lip + i * 3;
+                decodeints(&bs, 3, smallidx, sizesmall, recipsmall, thiscoord);
                 i++;
                 thiscoord[0] += prevcoord[0] - smallnum;
                 thiscoord[1] += prevcoord[1] - smallnum;
@@ -863,22 +1242,16 @@ xdrfile_decompress_coord_float(float *	ptr,
                     prevcoord[1] = tmp;
                     tmp = thiscoord[2]; thiscoord[2] = prevcoord[2];
                     prevcoord[2] = tmp;
-                    *lfp++ = prevcoord[0] * inv_precision;
-                    *lfp++ = prevcoord[1] * inv_precision;
-                    *lfp++ = prevcoord[2] * inv_precision;
+                    /* the atoms are now stored in buf1 in output order */
+                    thiscoord[-3] = prevcoord[0];
+                    thiscoord[-2] = prevcoord[1];
+                    thiscoord[-1] = prevcoord[2];
                 } else {
                     prevcoord[0] = thiscoord[0];
                     prevcoord[1] = thiscoord[1];
                     prevcoord[2] = thiscoord[2];
                 }
-                *lfp++ = thiscoord[0] * inv_precision;
-                *lfp++ = thiscoord[1] * inv_precision;
-                *lfp++ = thiscoord[2] * inv_precision;
             }
-        } else {
-            *lfp++ = thiscoord[0] * inv_precision;
-            *lfp++ = thiscoord[1] * inv_precision;
-            *lfp++ = thiscoord[2] * inv_precision;
         }
         smallidx += is_smaller;
         if (is_smaller < 0) {
@@ -893,10 +1266,96 @@ xdrfile_decompress_coord_float(float *	ptr,
             smallnum = magicints[smallidx] / 2;
         }
         sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+        recipsmall[0] = recipsmall[1] = recipsmall[2] = magicrecip[smallidx];
     }
+    if (ip != NULL)
+        memcpy(ip, buf1, sizeof(int) * size3);
+    else if (y == NULL)
+        dequantize(buf1, size3, inv_precision, ptr);
+    else
+        dequantize_soa(buf1, lsize, inv_precision, ptr, y, z);
     return *size;
 }
 
+int
+xdrfile_decompress_coord_float(float *	ptr,
+                               int *	size,
+                               float *	precision,
+                               XDRFILE *xfp)
+{
+    return decompress_coord_float(ptr, NULL, NULL, NULL, size, precision, xfp);
+}
+
+int
+xdrfile_decompress_coord_float_soa(float *	x,
+                                   float *	y,
+                                   float *	z,
+                                   int *	size,
+                                   float *	precision,
+                                   XDRFILE *xfp)
+{
+    if (x == NULL || y == NULL || z == NULL)
+        return -1;
+    return decompress_coord_float(x, y, z, NULL, size, precision, xfp);
+}
+
+int
+xdrfile_decompress_coord_int(int *	ptr,
+                             int *	size,
+                             float *	precision,
+                             XDRFILE *xfp)
+{
+    if (ptr == NULL)
+        return -1;
+    return decompress_coord_float(NULL, NULL, NULL, ptr, size, precision, xfp);
+}
+
+
+
+/* Moves the file position cnt bytes forward. Since seeking past the end of a
+ * file is not an error, we read the last byte to find out if the data is
+ * actually there, which matters for a truncated last frame.
+ */
+static int
+xdrfile_skip_bytes(XDRFILE *xfp, int64_t cnt)
+{
+    if (cnt <= 0)
+        return cnt == 0;
+    if (xfp->map) {
+        if (xfp->mappos + cnt > xfp->mapsize)
+            return 0;
+        xfp->mappos += cnt;
+        return 1;
+    }
+    if (fseeko(xfp->fp, (off_t)(cnt - 1), SEEK_CUR) != 0)
+        return 0;
+    return fgetc(xfp->fp) != EOF;
+}
+
+int
+xdrfile_skip_coord_float(int *ncoord, XDRFILE *xfp)
+{
+    int lsize, header[8], nbytes;
+
+    if (xfp == NULL || ncoord == NULL)
+        return -1;
+    if (xdrfile_read_int(&lsize, 1, xfp) == 0)
+        return -1; /* return if we could not read size */
+    *ncoord = lsize;
+    /* Uncompressed for three atoms or less */
+    if (lsize <= 9)
+        return xdrfile_skip_bytes(xfp, (int64_t)lsize * 3 * sizeof(float)) ? lsize : -1;
+    /* precision, minint[3], maxint[3] and smallidx come before the length */
+    if (xdrfile_read_int(header, 8, xfp) != 8)
+        return -1;
+    if (xdrfile_read_int(&nbytes, 1, xfp) == 0 || nbytes < 0)
+        return -1;
+    /* opaque data is padded to full 4-byte xdr units */
+    if (!xdrfile_skip_bytes(xfp, ((int64_t)nbytes + 3) & ~(int64_t)3))
+        return -1;
+    return lsize;
+}
+
 int
 xdrfile_compress_coord_float(float *	ptr,
                              int		size,
@@ -1159,7 +1618,10 @@ xdrfile_decompress_coord_double(double *	ptr,
     int minint[3], maxint[3], *lip;
     int smallidx, minidx, maxidx;
     unsigned sizeint[3], sizesmall[3], bitsizeint[3], size3;
-    int k, *buf1, *buf2, lsize, flag;
+    int k, *buf1, *buf2, lsize, flag, nbytes;
+    struct bitstream bs;
+    const unsigned char *cbuf;
+    uint64_t recipint[3], recipsmall[3];
     int smallnum, smaller, larger, i, is_smaller, run;
     double *lfp, inv_precision;
     float float_prec, tmpdata[30];
@@ -1225,6 +1687,9 @@ xdrfile_decompress_coord_double(double *	ptr,
         bitsize = 0; /* flag the use of large sizes */
     } else {
         bitsize = sizeofints(3, sizeint);
+        recipint[0] = reciprocal(sizeint[0]);
+        recipint[1] = reciprocal(sizeint[1]);
+        recipint[2] = reciprocal(sizeint[2]);
     }
 
     if (xdrfile_read_int(&smallidx, 1, xfp) == 0)
@@ -1237,15 +1702,16 @@ xdrfile_decompress_coord_double(double *	ptr,
     smaller = magicints[tmp] / 2;
     smallnum = magicints[smallidx] / 2;
     sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+    recipsmall[0] = recipsmall[1] = recipsmall[2] = magicrecip[smallidx];
     larger = magicints[maxidx];
 
-    /* buf2[0] holds the length in bytes */
+    /* nbytes holds the length of the compressed data in bytes */
 
-    if (xdrfile_read_int(buf2, 1, xfp) == 0)
+    if (xdrfile_read_int(&nbytes, 1, xfp) == 0)
         return 0;
-    if (xdrfile_read_opaque((char *)&(buf2[3]), (unsigned int)buf2[0], xfp) == 0)
+    if ((cbuf = getopaque(xfp, (char *)&(buf2[3]), nbytes)) == NULL)
         return 0;
-    buf2[0] = buf2[1] = buf2[2] = 0;
+    bitstream_init(&bs, cbuf, nbytes);
 
     lfp = ptr;
     inv_precision = 1.0 / *precision;
@@ -1256,11 +1722,11 @@ xdrfile_decompress_coord_double(double *	ptr,
         thiscoord = (int *)(lip) + i * 3;
 
         if (bitsize == 0) {
-            thiscoord[0] = decodebits(buf2, bitsizeint[0]);
-            thiscoord[1] = decodebits(buf2, bitsizeint[1]);
-            thiscoord[2] = decodebits(buf2, bitsizeint[2]);
+            thiscoord[0] = decodebits(&bs, bitsizeint[0]);
+            thiscoord[1] = decodebits(&bs, bitsizeint[1]);
+            thiscoord[2] = decodebits(&bs, bitsizeint[2]);
         } else {
-            decodeints(buf2, 3, bitsize, sizeint, thiscoord);
+            decodeints(&bs, 3, bitsize, sizeint, recipint, thiscoord);
         }
 
         i++;
@@ -1272,10 +1738,10 @@ xdrfile_decompress_coord_double(double *	ptr,
         prevcoord[1] = thiscoord[1];
         prevcoord[2] = thiscoord[2];
 
-        flag = decodebits(buf2, 1);
+        flag = decodebits(&bs, 1);
         is_smaller = 0;
         if (flag == 1) {
-            run = decodebits(buf2, 5);
+            run = decodebits(&bs, 5);
             is_smaller = run % 3;
             run -= is_smaller;
             is_smaller--;
@@ -1283,7 +1749,7 @@ xdrfile_decompress_coord_double(double *	ptr,
         if (run > 0) {
             thiscoord += 3;
             for (k = 0; k < run; k += 3) {
-                decodeints(buf2, 3, smallidx, sizesmall, thiscoord);
+                decodeints(&bs, 3, smallidx, sizesmall, recipsmall, thiscoord);
                 i++;
                 thiscoord[0] += prevcoord[0] - smallnum;
                 thiscoord[1] += prevcoord[1] - smallnum;
@@ -1327,6 +1793,7 @@ xdrfile_decompress_coord_double(double *	ptr,
             smallnum = magicints[smallidx] / 2;
         }
         sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+        recipsmall[0] = recipsmall[1] = recipsmall[2] = magicrecip[smallidx];
     }
     return *size;
 }
@@ -2309,8 +2776,8 @@ static int xdrstdio_getlong(XDR *, int32_t *);
 static int xdrstdio_putlong(XDR *, int32_t *);
 static int xdrstdio_getbytes(XDR *, char *, unsigned int);
 static int xdrstdio_putbytes(XDR *, char *, unsigned int);
-static unsigned int xdrstdio_getpos(XDR *);
-static int xdrstdio_setpos(XDR *, unsigned int);
+static int64_t xdrstdio_getpos(XDR *);
+static int xdrstdio_setpos(XDR *, int64_t);
 static void xdrstdio_destroy(XDR *);
 
 /*
@@ -2392,18 +2859,114 @@ xdrstdio_putbytes(XDR *xdrs, char *addr, unsigned int len)
     return 1;
 }
 
-/* 32 bit fileseek operations */
-static unsigned int
+/* 64 bit fileseek operations */
+static int64_t
 xdrstdio_getpos(XDR *xdrs)
 {
-    return (unsigned int)ftell((FILE *)xdrs->x_private);
+    return (int64_t)ftello((FILE *)xdrs->x_private);
+}
+
+static int
+xdrstdio_setpos(XDR *xdrs, int64_t pos)
+{
+    return fseeko((FILE *)xdrs->x_private, (off_t)pos, SEEK_SET) < 0 ? 0 : 1;
+}
+
+
+
+#ifdef XDRFILE_MMAP
+static int xdrmmap_getlong(XDR *, int32_t *);
+static int xdrmmap_putlong(XDR *, int32_t *);
+static int xdrmmap_getbytes(XDR *, char *, unsigned int);
+static int xdrmmap_putbytes(XDR *, char *, unsigned int);
+static int64_t xdrmmap_getpos(XDR *);
+static int xdrmmap_setpos(XDR *, int64_t);
+static void xdrmmap_destroy(XDR *);
+
+/*
+ * Ops vector for memory-mapped xdr, reading straight from the page cache
+ */
+static const struct xdr_ops xdrmmap_ops =
+{
+    xdrmmap_getlong,            /* deserialize a long int */
+    xdrmmap_putlong,            /* serialize a long int */
+    xdrmmap_getbytes,           /* deserialize counted bytes */
+    xdrmmap_putbytes,           /* serialize counted bytes */
+    xdrmmap_getpos,             /* get offset in the stream */
+    xdrmmap_setpos,             /* set offset in the stream */
+    xdrmmap_destroy,            /* destroy stream */
+};
+
+/*
+ * Initialize a memory-mapped xdr stream. The map and the current position
+ * are kept in the XDRFILE, so that is what x_private points to. Only
+ * decoding is supported.
+ */
+static void
+xdrmmap_create(XDR *xdrs, XDRFILE *xfp, enum xdr_op op)
+{
+    xdrs->x_op = op;
+
+    xdrs->x_ops = (struct xdr_ops *)&xdrmmap_ops;
+    xdrs->x_private = (char *)xfp;
+}
+
+static void
+xdrmmap_destroy(XDR *xdrs)
+{
+    /* the map is released in xdrfile_close */
+}
+
+static int
+xdrmmap_getlong(XDR *xdrs, int32_t *lp)
+{
+    XDRFILE *xfp = (XDRFILE *)xdrs->x_private;
+    int32_t mycopy;
+
+    if (xfp->mappos + 4 > xfp->mapsize)
+        return 0;
+    memcpy(&mycopy, xfp->map + xfp->mappos, 4);
+    xfp->mappos += 4;
+    *lp = (int32_t)xdr_ntohl(mycopy);
+    return 1;
+}
+
+static int
+xdrmmap_putlong(XDR *xdrs, int32_t *lp)
+{
+    return 0;
+}
+
+static int
+xdrmmap_getbytes(XDR *xdrs, char *addr, unsigned int len)
+{
+    XDRFILE *xfp = (XDRFILE *)xdrs->x_private;
+
+    if (xfp->mappos + len > xfp->mapsize)
+        return 0;
+    memcpy(addr, xfp->map + xfp->mappos, len);
+    xfp->mappos += len;
+    return 1;
+}
+
+static int
+xdrmmap_putbytes(XDR *xdrs, char *addr, unsigned int len)
+{
+    return 0;
+}
+
+static int64_t
+xdrmmap_getpos(XDR *xdrs)
+{
+    return ((XDRFILE *)xdrs->x_private)->mappos;
 }
 
 static int
-xdrstdio_setpos(XDR *xdrs, unsigned int pos)
+xdrmmap_setpos(XDR *xdrs, int64_t pos)
 {
-    return fseek((FILE *)xdrs->x_private, pos, 0) < 0 ? 0 : 1;
+    return xdrfile_seek((XDRFILE *)xdrs->x_private, pos, SEEK_SET) == 0;
 }
+#endif /* XDRFILE_MMAP */
 
 
 
@@ -12,8 +12,8 @@
  */
 
 #include <stdlib.h>
-#include "gmxcpp/xdrfile.h"
-#include "gmxcpp/xdrfile_xtc.h"
+#include "xdrfile.h"
+#include "xdrfile_xtc.h"
 
 #define MAGIC 1995
 
@@ -97,6 +97,62 @@ int read_xtc(XDRFILE *xd,
     return exdrOK;
 }
 
+int read_xtc_soa(XDRFILE *xd,
+                 int natoms, int *step, float *time,
+                 matrix box, float *x, float *y, float *z, float *prec)
+/* Read subsequent frames into separate x, y and z arrays */
+{
+    int result;
+
+    if ((result = xtc_header(xd, &natoms, step, time, TRUE)) != exdrOK)
+        return result;
+
+    if (xdrfile_read_float(box[0], DIM * DIM, xd) != DIM * DIM)
+        return exdrFLOAT;
+
+    if (xdrfile_decompress_coord_float_soa(x, y, z, &natoms, prec, xd) != natoms)
+        return exdr3DX;
+
+    return exdrOK;
+}
+
+int read_xtc_int(XDRFILE *xd,
+                 int natoms, int *step, float *time,
+                 matrix box, int *x, float *prec)
+/* Read subsequent frames as the integers the coordinates are stored as */
+{
+    int result;
+
+    if ((result = xtc_header(xd, &natoms, step, time, TRUE)) != exdrOK)
+        return result;
+
+    if (xdrfile_read_float(box[0], DIM * DIM, xd) != DIM * DIM)
+        return exdrFLOAT;
+
+    if (xdrfile_decompress_coord_int(x, &natoms, prec, xd) != natoms)
+        return exdr3DX;
+
+    return exdrOK;
+}
+
+int skip_xtc(XDRFILE *xd,
+             int natoms, int *step, float *time, matrix box)
+/* Skip subsequent frames */
+{
+    int result;
+
+    if ((result = xtc_header(xd, &natoms, step, time, TRUE)) != exdrOK)
+        return result;
+
+    if (xdrfile_read_float(box[0], DIM * DIM, xd) != DIM * DIM)
+        return exdrFLOAT;
+
+    if (xdrfile_skip_coord_float(&natoms, xd) < 0)
+        return exdr3DX;
+
+    return exdrOK;
+}
+
 int write_xtc(XDRFILE *xd,
               int natoms, int step, float time,
               matrix box, rvec *x, float prec)
@@ -1,11 +1,22 @@
 #include <assert.h>
 #include "tests.h"
 #include "gmxcpp/coordinates.h"
+#include "gmxcpp/FrameIndex.h"
 #include "gmxcpp/triclinicbox.h"
 #include "gmxcpp/Trajectory.h"
+#include "gmxcpp/TrajectoryClient.h"
+#include "gmxcpp/TrajectoryServer.h"
+#include "gmxcpp/XtcWriter.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <thread>
 
 int main()
 {
+    /* The frame index is built by the tests, not loaded from a previous run. */
+    remove("tests/test.xtc.idx");
+
     Trajectory t1("tests/test.xtc");
     t1.read();
 
@@ -119,4 +130,354 @@ int main()
     assert(test_equal(tc10[Y], 1.206));
     assert(test_equal(tc10[Z], 1.413));
 
+    Trajectory t6("tests/test.xtc", index);
+    assert(t6.skip_next(1000) == 1000);
+    assert(t6.read_next() == 1);
+    coordinates tc11 = t6.GetXYZ(0, "OW", 999);
+    assert(test_equal(tc11[X], 1.040));
+    assert(test_equal(tc11[Y], 1.206));
+    assert(test_equal(tc11[Z], 1.413));
+    assert(t6.skip_next(5) == 0);
+    assert(t6.read_next() == 0);
+
+    Trajectory t7("tests/test.xtc", index);
+    t7.SetNumThreads(4);
+    t7.read(0, 5);
+    assert(test_equal(t7.GetNFrames(), 201));
+    assert(test_equal(t7.GetStep(200), 1000000));
+    coordinates tc12 = t7.GetXYZ(200, "OW", 999);
+    assert(test_equal(tc12[X], 1.040));
+    assert(test_equal(tc12[Y], 1.206));
+    assert(test_equal(tc12[Z], 1.413));
+
+    Trajectory t8("tests/test.xtc", index);
+    t8.SetPrefetch(8);
+    assert(t8.read_next(4) == 4);
+    assert(test_equal(t8.GetStep(3), 3000));
+    assert(t8.skip_next(996) == 996);
+    assert(t8.read_next(4) == 1);
+    coordinates tc13 = t8.GetXYZ(0, "OW", 999);
+    assert(test_equal(tc13[X], 1.040));
+    assert(test_equal(tc13[Y], 1.206));
+    assert(test_equal(tc13[Z], 1.413));
+
+    Trajectory t9("tests/test.xtc", index);
+    t9.read(0, 5, -1, "OW");
+    assert(test_equal(t9.GetNFrames(), 201));
+    assert(test_equal(t9.GetXYZ(200).size(), 1000));
+    coordinates tc14 = t9.GetXYZ(200, "OW", 999);
+    assert(test_equal(tc14[X], 1.040));
+    assert(test_equal(tc14[Y], 1.206));
+    assert(test_equal(tc14[Z], 1.413));
+
+    Trajectory t10("tests/test.xtc", index);
+    t10.SetHugePages(true);
+    t10.read(0, 10);
+    assert(test_equal(t10.GetNFrames(), 101));
+    coordinates tc15 = t10.GetXYZ(100, "OW", 999);
+    assert(test_equal(tc15[X], 1.040));
+    assert(test_equal(tc15[Y], 1.206));
+    assert(test_equal(tc15[Z], 1.413));
+
+    bool threw = false;
+    try
+    {
+        t10.GetVelocity(0, 0);
+    }
+    catch (runtime_error &e)
+    {
+        threw = true;
+    }
+    assert(threw);
+
+    Trajectory t11("tests/test.xtc", index);
+    int nstream = 0;
+    for (const Frame &frame : t11.stream(0, 5))
+    {
+        assert(test_equal(frame.GetStep(), nstream * 5000));
+        ++nstream;
+    }
+    assert(test_equal(nstream, 201));
+    assert(test_equal(t11.GetNFrames(), 0));
+
+    assert(test_equal(FrameCache::Write("tests/test.xtc"), 1001));
+    Trajectory t12("tests/test.xtc.cache", index);
+    t12.read(0, 5);
+    assert(test_equal(t12.GetNFrames(), 201));
+    assert(test_equal(t12.GetStep(200), 1000000));
+    coordinates tc16 = t12.GetXYZ(200, "OW", 999);
+    assert(test_equal(tc16[X], 1.040));
+    assert(test_equal(tc16[Y], 1.206));
+    assert(test_equal(tc16[Z], 1.413));
+    remove("tests/test.xtc.cache");
+
+    Trajectory t13("tests/test.xtc", index);
+    t13.SetCompressedStore(4);
+    t13.read(0, 5);
+    assert(test_equal(t13.GetNFrames(), 201));
+    assert(test_equal(t13.GetStep(200), 1000000));
+    coordinates tc17 = t13.GetXYZ(200, "OW", 999);
+    assert(test_equal(tc17[X], 1.040));
+    assert(test_equal(tc17[Y], 1.206));
+    assert(test_equal(tc17[Z], 1.413));
+
+    Trajectory t14("tests/test.xtc", index);
+    t14.SetQuantized(true);
+    t14.read(0, 5);
+    assert(test_equal(t14.GetNFrames(), 201));
+    coordinates tc18 = t14.GetXYZ(200, "OW", 999);
+    assert(test_equal(tc18[X], 1.040));
+    assert(test_equal(tc18[Y], 1.206));
+    assert(test_equal(tc18[Z], 1.413));
+
+    Trajectory t15("tests/test.xtc", index);
+    t15.read_time(1000.0, -1, 10.0);
+    assert(test_equal(t15.GetNFrames(), 101));
+    assert(test_equal(t15.GetTime(0), 1000.0));
+    assert(test_equal(t15.GetStep(100), 1000000));
+    coordinates tc19 = t15.GetXYZ(100, "OW", 999);
+    assert(test_equal(tc19[X], 1.040));
+    assert(test_equal(tc19[Y], 1.206));
+    assert(test_equal(tc19[Z], 1.413));
+
+    vector <string> parts = { "tests/test.xtc", "tests/test.xtc" };
+    Trajectory t16(parts, index);
+    t16.read(0, 1, -1, "OW");
+    assert(test_equal(t16.GetNFrames(), 2002));
+    assert(test_equal(t16.GetStep(1000), 1000000));
+    assert(test_equal(t16.GetStep(1001), 0));
+    coordinates tc20 = t16.GetXYZ(2001, "OW", 999);
+    assert(test_equal(tc20[X], 1.040));
+    assert(test_equal(tc20[Y], 1.206));
+    assert(test_equal(tc20[Z], 1.413));
+
+    XtcWriter writer("tests/written.xtc", 2);
+    for (int i = 0; i < t15.GetNFrames(); i++)
+    {
+        writer.Write(t15, i, "OW");
+    }
+    writer.Close();
+    Trajectory t17("tests/written.xtc");
+    t17.read();
+    assert(test_equal(t17.GetNFrames(), 101));
+    assert(test_equal(t17.GetNAtoms(), 1000));
+    assert(test_equal(t17.GetStep(100), 1000000));
+    coordinates tc21 = t17.GetXYZ(100, 999);
+    assert(test_equal(tc21[X], 1.040));
+    assert(test_equal(tc21[Y], 1.206));
+    assert(test_equal(tc21[Z], 1.413));
+    remove("tests/written.xtc");
+    remove("tests/written.xtc.idx");
+
+    Trajectory t18("tests/test.xtc", index);
+    t18.skip_next(990);
+    int lastStep = 0;
+    int nfollowed = t18.follow([&](const Frame &frame) { lastStep = frame.GetStep(); return true; }, 0);
+    assert(test_equal(nfollowed, 11));
+    assert(test_equal(lastStep, 1000000));
+
+    /* Frame 10 is appended in two parts while following, so the first part
+     * is an incomplete frame which must not be returned. */
+    FrameIndex fi("tests/test.xtc");
+    vector <char> bytes(fi.GetOffset(11));
+    {
+        ifstream in("tests/test.xtc", ios::binary);
+        in.read(bytes.data(), bytes.size());
+        ofstream out("tests/grow.xtc", ios::binary);
+        out.write(bytes.data(), fi.GetOffset(10));
+    }
+    Trajectory t27("tests/grow.xtc");
+    assert(test_equal(t27.skip_next(10), 10));
+    thread appending([&]()
+    {
+        const int64_t half = (fi.GetOffset(10) + fi.GetOffset(11)) / 2;
+        ofstream out("tests/grow.xtc", ios::binary | ios::app);
+        this_thread::sleep_for(chrono::milliseconds(50));
+        out.write(bytes.data() + fi.GetOffset(10), half - fi.GetOffset(10));
+        out.flush();
+        this_thread::sleep_for(chrono::milliseconds(100));
+        out.write(bytes.data() + half, fi.GetOffset(11) - half);
+        out.flush();
+    });
+    vector <int> followed;
+    nfollowed = t27.follow([&](const Frame &frame) { followed.push_back(frame.GetStep()); return true; }, 1.0);
+    appending.join();
+    assert(test_equal(nfollowed, 1));
+    assert(test_equal(followed.size(), 1));
+    assert(test_equal(followed[0], 10000));
+    remove("tests/grow.xtc");
+    remove("tests/grow.xtc.idx");
+
+    /* A part continuing from the last frame of the one before starts with the
+     * same step, which is only read from the first. Its first frame has other
+     * coordinates so it is clear which was kept. */
+    XtcWriter next("tests/next.xtc");
+    next.Write(t1.GetStep(1000), t1.GetTime(1000), t1.GetBox(1000), t1.GetXYZ(500));
+    next.Write(1001000, 2002.0, t1.GetBox(999), t1.GetXYZ(999));
+    next.Write(1002000, 2004.0, t1.GetBox(998), t1.GetXYZ(998));
+    next.Close();
+    vector <string> continued = { "tests/test.xtc", "tests/next.xtc" };
+    Trajectory t28(continued, index);
+    t28.read();
+    assert(test_equal(t28.GetNFrames(), 1003));
+    assert(test_equal(t28.GetStep(999), 999000));
+    assert(test_equal(t28.GetStep(1000), 1000000));
+    assert(test_equal(t28.GetStep(1001), 1001000));
+    assert(test_equal(t28.GetStep(1002), 1002000));
+    assert(test_equal(t28.GetTime(1001), 2002.0));
+    coordinates tc29 = t28.GetXYZ(1000, "OW", 999);
+    assert(test_equal(tc29[X], 1.040));
+    assert(test_equal(tc29[Y], 1.206));
+    assert(test_equal(tc29[Z], 1.413));
+    coordinates tc30 = t28.GetXYZ(1001, 4049);
+    assert(test_equal(tc30[X], t1.GetXYZ(999, 4049)[X]));
+    assert(test_equal(tc30[Y], t1.GetXYZ(999, 4049)[Y]));
+    assert(test_equal(tc30[Z], t1.GetXYZ(999, 4049)[Z]));
+    remove("tests/next.xtc");
+    remove("tests/next.xtc.idx");
+
+    Trajectory t19("tests/test.xtc", index);
+    t19.SetMemoryBudget(1 << 20);
+    t19.read();
+    assert(test_equal(t19.GetNFrames(), 1001));
+    for (int i = 0; i < t19.GetNFrames(); i++)
+    {
+        t19.GetXYZ(i, "OW", 0);
+    }
+    coordinates tc22 = t19.GetXYZ(1000, "OW", 999);
+    assert(test_equal(tc22[X], 1.040));
+    assert(test_equal(tc22[Y], 1.206));
+    assert(test_equal(tc22[Z], 1.413));
+
+    Trajectory t20("tests/test.xtc", index);
+    TrajectoryWindow window = t20.window(10, 990, "OW");
+    assert(test_equal(window.Advance(20), 11));
+    assert(test_equal(window.GetFirst(), 991));
+    assert(test_equal(window.GetLast(), 1000));
+    assert(test_equal(window.GetStep(1000), 1000000));
+    coordinates tc23 = window.GetXYZ(1000, 999);
+    assert(test_equal(tc23[X], 1.040));
+    assert(test_equal(tc23[Y], 1.206));
+    assert(test_equal(tc23[Z], 1.413));
+    assert(!window.Advance());
+    assert(test_equal(window.GetFirst(), 991));
+    assert(test_equal(window.GetStep(991), 991000));
+    assert(test_equal(window.GetStep(1000), 1000000));
+    assert(test_equal(window.GetXYZ(991, 999)[X], t19.GetXYZ(991, "OW", 999)[X]));
+    TrajectoryWindow whole = t20.window(3, 999);
+    while (whole.Advance());
+    assert(test_equal(whole.GetFirst(), 999));
+    assert(test_equal(whole.GetStep(whole.GetFirst()), 999000));
+    assert(test_equal(whole.GetXYZ(999, 4049)[X], t19.GetXYZ(999, 4049)[X]));
+
+    assert(test_equal(FrameCache::Publish("tests/test.xtc", "/gmxcpp-test", 2), 1001));
+    Trajectory t21("shm:/gmxcpp-test", index);
+    FrameCache::Unpublish("/gmxcpp-test");
+    t21.read(0, 5);
+    assert(test_equal(t21.GetNFrames(), 201));
+    assert(test_equal(t21.GetStep(200), 1000000));
+    coordinates tc24 = t21.GetXYZ(200, "OW", 999);
+    assert(test_equal(tc24[X], 1.040));
+    assert(test_equal(tc24[Y], 1.206));
+    assert(test_equal(tc24[Z], 1.413));
+
+    TrajectoryServer server("gmxcpp-test.sock", 64 << 20);
+    thread serving(&TrajectoryServer::Run, &server);
+    {
+        TrajectoryClient t22("gmxcpp-test.sock", "tests/test.xtc", "tests/test.ndx");
+        assert(test_equal(t22.GetNFrames(), 1001));
+        assert(test_equal(t22.GetNAtoms("OW"), 1000));
+        assert(test_equal(t22.GetStep(1000), 1000000));
+        assert(test_equal(t22.GetTime(1000), 2000.0));
+        coordinates tc25 = t22.GetXYZ(1000, "OW", 999);
+        assert(test_equal(tc25[X], 1.040));
+        assert(test_equal(tc25[Y], 1.206));
+        assert(test_equal(tc25[Z], 1.413));
+    }
+    server.Stop();
+    serving.join();
+
+    Trajectory t23("tests/test.xtc", index);
+    t23.SetPrefetch(8);
+    assert(t23.read_next(2) == 2);
+    assert(t23.read_next(2, "OW") == 2);
+    assert(test_equal(t23.GetStep(0), 2000));
+    assert(test_equal(t23.GetStep(1), 3000));
+    assert(test_equal(t23.GetXYZ(1).size(), 1000));
+
+    Trajectory t24("tests/test.xtc", index);
+    t24.read(0, 1, 2000000000);
+    assert(test_equal(t24.GetNFrames(), 1001));
+    assert(test_equal(t24.GetStep(1000), 1000000));
+
+    Trajectory t25("tests/test.trr");
+    t25.read();
+    assert(test_equal(t25.GetNFrames(), 3));
+    assert(test_equal(t25.GetStep(2), 20));
+    assert(test_equal(t25.GetTime(1), 0.5));
+    assert(t25.HasPositions(0) && !t25.HasPositions(1) && t25.HasPositions(2));
+    coordinates tc26 = t25.GetXYZ(0, 1);
+    assert(test_equal(tc26[X], 1.0));
+    assert(test_equal(tc26[Y], 1.25));
+    assert(test_equal(tc26[Z], 1.5));
+    coordinates tc27 = t25.GetVelocity(1, 2);
+    assert(test_equal(tc27[X], 8.0));
+    assert(test_equal(tc27[Y], 0.0));
+    assert(test_equal(tc27[Z], -0.5));
+    coordinates tc28 = t25.GetForce(2, 0);
+    assert(test_equal(tc28[X], 10.0));
+    assert(test_equal(tc28[Y], -20.0));
+    assert(test_equal(tc28[Z], 30.0));
+    threw = false;
+    try
+    {
+        t25.GetForce(1, 0);
+    }
+    catch (runtime_error &e)
+    {
+        threw = true;
+    }
+    assert(threw);
+    assert(test_equal(t25.GetBox(1)(Y, Y), 2.5));
+
+    {
+        ifstream in("tests/test.xtc", ios::binary);
+        ofstream out("tests/gone.xtc", ios::binary);
+        out << in.rdbuf();
+    }
+    Trajectory t26("tests/gone.xtc");
+    remove("tests/gone.xtc");
+    t26.SetThrowOnError(true);
+    threw = false;
+    try
+    {
+        t26.read(0, 2);
+    }
+    catch (runtime_error &e)
+    {
+        threw = true;
+    }
+    assert(threw);
+
+    string longName = "tests/";
+    for (int i = 0; i < 150; i++)
+    {
+        longName += "./";
+    }
+    Trajectory t29(longName + "test.xtc", index);
+    t29.read(1000, 1);
+    assert(test_equal(t29.GetNFrames(), 1));
+    assert(test_equal(t29.GetStep(0), 1000000));
+    threw = false;
+    try
+    {
+        Trajectory t30("tests/test.ndx");
+    }
+    catch (runtime_error &e)
+    {
+        threw = true;
+    }
+    assert(threw);
+
+    remove("tests/test.xtc.idx");
 }
@@ -0,0 +1,146 @@
+#include <assert.h>
+#include "tests.h"
+#include "gmxcpp/coordinates.h"
+#include "xdrfile_xtc.h"
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace std;
+
+/* Decodes every frame of an xtc file with read_xtc and with read_xtc_soa, which
+ * must give exactly the same coordinates. Returns the number of frames. */
+int compare_soa(const char *xtcfile)
+{
+    int natoms;
+    assert(read_xtc_natoms((char*) xtcfile, &natoms) == exdrOK);
+    XDRFILE *aos = xdrfile_open(xtcfile, "r");
+    XDRFILE *soa = xdrfile_open(xtcfile, "r");
+    assert(aos != NULL && soa != NULL);
+
+    vector <float> x(natoms * DIM);
+    vector <float> sx(natoms), sy(natoms), sz(natoms);
+    int nframes = 0;
+    while (true)
+    {
+        int step, sstep;
+        float time, stime, prec, sprec;
+        matrix box, sbox;
+        int status = read_xtc(aos, natoms, &step, &time, box, (rvec*) x.data(), &prec);
+        int sstatus = read_xtc_soa(soa, natoms, &sstep, &stime, sbox, sx.data(), sy.data(), sz.data(), &sprec);
+        assert(status == sstatus);
+        if (status != exdrOK)
+        {
+            break;
+        }
+        assert(step == sstep && time == stime && prec == sprec);
+        for (int i = 0; i < natoms; i++)
+        {
+            assert(x[DIM * i + X] == sx[i]);
+            assert(x[DIM * i + Y] == sy[i]);
+            assert(x[DIM * i + Z] == sz[i]);
+        }
+        ++nframes;
+    }
+    xdrfile_close(aos);
+    xdrfile_close(soa);
+    return nframes;
+}
+
+/* Coordinates are stored as integers, exactly, so decoding must give back the
+ * integers write_xtc rounded them to. Each case takes a different path through
+ * the decoder: up to 9 atoms are stored as plain floats, a range of more than
+ * 2^24 units in a dimension is stored with each of its integers sized
+ * separately, and a dimension where all atoms are the same has no range at
+ * all. Atoms are in close pairs, as in water, so runs of small differences
+ * are decoded too. */
+void check_case(int natoms, float prec, int range, bool flat)
+{
+    const char *xtcfile = "tests/cases.xtc";
+    const int nframes = 3;
+    const int n = nframes * natoms * DIM;
+    const float inv = 1.0 / prec;
+
+    /* The same pseudo-random numbers on every machine. */
+    unsigned int seed = natoms * 7919 + range;
+    vector <float> x(n);
+    vector <int> q(n);
+    for (int i = 0; i < n; i++)
+    {
+        const int atom = i / DIM % natoms;
+        seed = seed * 1103515245 + 12345;
+        int r = (int) (seed % (range + 1)) - range / 2;
+        if (atom % 2 == 1)
+        {
+            r = lrint(x[i - DIM] * prec) + (int) ((seed >> 16) % 21) - 10;
+        }
+        if (flat && i % DIM == Z)
+        {
+            r = range / 3;
+        }
+        x[i] = r / prec;
+
+        /* Rounded as write_xtc does, which for more than 2^23 units is not
+         * always to the nearest integer. */
+        const float lf = (x[i] >= 0.0) ? x[i] * prec + 0.5 : x[i] * prec - 0.5;
+        q[i] = lf;
+    }
+
+    matrix box = { { 5.0, 0.0, 0.0 }, { 0.0, 5.0, 0.0 }, { 0.0, 0.0, 5.0 } };
+    XDRFILE *xd = xdrfile_open(xtcfile, "w");
+    assert(xd != NULL);
+    for (int f = 0; f < nframes; f++)
+    {
+        assert(write_xtc(xd, natoms, f, f, box, (rvec*) &x[f * natoms * DIM], prec) == exdrOK);
+    }
+    xdrfile_close(xd);
+
+    int step;
+    float time, p;
+    matrix b;
+    vector <float> fx(natoms * DIM);
+    xd = xdrfile_open(xtcfile, "r");
+    for (int f = 0; f < nframes; f++)
+    {
+        assert(read_xtc(xd, natoms, &step, &time, b, (rvec*) fx.data(), &p) == exdrOK);
+        assert(step == f);
+        for (int i = 0; i < natoms * DIM; i++)
+        {
+            const int at = f * natoms * DIM + i;
+            assert(fx[i] == ((natoms <= 9) ? x[at] : q[at] * inv));
+        }
+    }
+    assert(read_xtc(xd, natoms, &step, &time, b, (rvec*) fx.data(), &p) != exdrOK);
+    xdrfile_close(xd);
+
+    /* The integers themselves, where there are any. */
+    if (natoms > 9)
+    {
+        vector <int> ix(natoms * DIM);
+        xd = xdrfile_open(xtcfile, "r");
+        for (int f = 0; f < nframes; f++)
+        {
+            assert(read_xtc_int(xd, natoms, &step, &time, b, ix.data(), &p) == exdrOK);
+            for (int i = 0; i < natoms * DIM; i++)
+            {
+                assert(ix[i] == q[f * natoms * DIM + i]);
+            }
+        }
+        xdrfile_close(xd);
+    }
+    remove(xtcfile);
+}
+
+int main()
+{
+    check_case(1, 1000.0, 5000, false);
+    check_case(9, 1000.0, 5000, false);
+    check_case(10, 1000.0, 5000, false);
+    check_case(300, 1000.0, 5000, false);
+    check_case(300, 1000.0, 5000, true);
+    check_case(200, 1.0, 20000000, false);
+    check_case(200, 1.0, 20000000, true);
+
+    assert(compare_soa("tests/test.xtc") == 1001);
+    assert(compare_soa("tests/clustertest.xtc") > 0);
+}